@@ -1,14 +1,180 @@
+#define _POSIX_C_SOURCE 200809L // mmap, posix_madvise, pthreads, sysconf and clock_gettime
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdarg.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <limits.h>
+#include <float.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+// SIMD kernels are built with per-function target attributes and picked at runtime
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STRING_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+// The benchmark suite is built on the STRING_BENCHMARK helpers
+#if defined(STRING_BENCHMARK_SUITE) && !defined(STRING_BENCHMARK)
+#define STRING_BENCHMARK 1
+#endif
+
+// Storage kinds for the data of a String
+#define STRING_STORAGE_HEAP 0   // data was malloc'd and is released by free_string
+#define STRING_STORAGE_ARENA 1  // data lives in a StringArena and is released with the arena
+#define STRING_STORAGE_INLINE 2 // data is stored inside the String itself
+#define STRING_STORAGE_SHARED 3 // data is in a refcounted SharedBuffer that copies of the String point at too
 
-// Define a struct to represent a string with its length
+// Longest string that is stored inline instead of on the heap
+#define STRING_SSO_CAPACITY 22
+
+// Define a struct to represent a string with its length, in 32 bytes
+// Always reach the characters through string_data() and the capacity through string_capacity(),
+// which handle both layouts. The storage kind sits in the last byte of buf for every kind: after
+// an inline string's characters and null terminator, or in the spare bytes behind data and capacity.
 typedef struct {
-    char *data;
+    union {
+        struct {
+            char *data;      // Heap, arena or shared storage
+            size_t capacity; // Characters data can hold without growing, not counting the null terminator
+            unsigned char spare[STRING_SSO_CAPACITY + 1 - sizeof(char *) - sizeof(size_t)];
+            unsigned char storage; // One of the STRING_STORAGE_* kinds
+        };
+        char inline_data[STRING_SSO_CAPACITY + 2]; // Short strings, null-terminated, then the storage byte
+    } buf;
     size_t length;
 } String;
 
+// Define a struct to represent the heap block behind STRING_STORAGE_SHARED Strings
+// Every String whose data points at the characters holds one reference
+typedef struct {
+    atomic_size_t refs;
+    char data[]; // capacity + 1 bytes, null-terminated
+} SharedBuffer;
+
+// Define a struct to represent a non-owning window into someone else's characters
+// A view is not null-terminated and stays valid only as long as its source does
+typedef struct {
+    const char *ptr;
+    size_t len;
+} StringView;
+
+// Returned by the view search functions when there is no match
+#define STRING_NOT_FOUND ((size_t)-1)
+
+// Signature shared by the scalar, SSE2 and AVX2 substring search kernels
+typedef size_t (*SearchKernel)(const char *haystack, size_t haystack_len, const char *needle, size_t needle_len);
+
+// Define a struct to represent a needle prepared once for searching many haystacks
+typedef struct {
+    char *needle;        // Owned copy of the needle
+    size_t length;
+    SearchKernel kernel; // Best kernel for this CPU and needle length
+} StringSearcher;
+
+// Define a struct to represent one rule for replace_many: every target becomes its replacement
+typedef struct {
+    StringView target;
+    StringView replacement;
+} ReplacePair;
+
+// Define a struct to represent a set of replacement rules compiled into an Aho-Corasick automaton
+typedef struct {
+    int32_t *next;            // Full transition table, next[state * 256 + byte]
+    int32_t *output;          // Rule of the longest target ending in each state, or -1
+    int32_t *depth;           // Length of the trie path to each state: how far back a match in progress started
+    size_t *target_lengths;   // Length of each rule's target
+    StringView *replacements; // Each rule's replacement, pointing into storage
+    char *storage;            // Owned copy of the replacement bytes
+    size_t count;             // Number of rules
+} Replacer;
+
+// Define a struct to represent a growable buffer for building a String piece by piece
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity; // Bytes allocated, not counting the null terminator
+} StringBuilder;
+
+// Flags for create_stream_tokenizer
+#define TOKENIZER_DELIMITER_SET 1 // Every byte of the delimiter ends a token, instead of the whole sequence
+#define TOKENIZER_SKIP_EMPTY 2    // Never yield empty tokens, like strtok
+
+// Define a struct to represent a tokenizer fed with chunks of an unbounded input
+typedef struct {
+    char *delimiter;                 // Owned copy of the delimiter sequence
+    size_t delimiter_length;
+    unsigned char is_delimiter[256]; // Delimiter bytes, for TOKENIZER_DELIMITER_SET
+    int flags;
+    char *carry;                     // Start of a token that did not end in its chunk
+    size_t carry_length;
+    size_t carry_capacity;
+    int carry_returned;              // The carry was handed out as a token and is dropped on the next call
+    const char *chunk;               // Chunk being consumed, owned by the caller
+    size_t chunk_length;
+    size_t position;
+    int finished;                    // No more chunks will come
+    int done;                        // The last token was handed out
+} StreamTokenizer;
+
+// Define a struct to represent the state of a streaming RLE encoder between chunks
+typedef struct {
+    unsigned char tail_byte; // Byte of the run that reached the end of the last chunk
+    uint64_t tail_count;     // Length of that run, 0 when there is none
+} RleEncoder;
+
+// Most bytes decompress_string and rle_decoder_feed will produce; a record declaring more is
+// treated as malformed, so a few bytes of hostile input cannot make the allocation fail and exit
+#ifndef RLE_MAX_DECODED
+#define RLE_MAX_DECODED ((size_t)1 << 30)
+#endif
+
+// Define a struct to represent the state of a streaming RLE decoder between chunks
+typedef struct {
+    int state;          // Which part of a record comes next: RLE_DECODE_HEADER, _LITERAL or _RUN_BYTE
+    uint64_t value;     // Header being read, or bytes left of the current record
+    unsigned shift;     // Bits of the header read so far
+} RleDecoder;
+
+// Most shifted byte ranges a ByteMap applies with SIMD compares
+#define BYTE_MAP_MAX_RANGES 8
+
+// Define a struct to represent a byte-to-byte mapping compiled for transform_bytes
+// Maps made of a few ranges shifted by a constant (case mapping, Caesar shifts) are applied with
+// SIMD range compares; any other map is applied through its 256-entry table
+typedef struct {
+    size_t range_count;                          // 0 when the table must be used
+    unsigned char low[BYTE_MAP_MAX_RANGES];      // First byte of each range
+    unsigned char high[BYTE_MAP_MAX_RANGES];     // Last byte of each range
+    unsigned char delta[BYTE_MAP_MAX_RANGES];    // Added to every byte of the range, modulo 256
+    unsigned char table[256];                    // Only filled in when range_count is 0
+} ByteMap;
+
+// Define a struct to represent one chunk of a StringArena
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;
+    size_t used;
+    size_t capacity;
+    char data[];
+} ArenaChunk;
+
+// Define a struct to represent a bump allocator that many Strings can share
+typedef struct {
+    ArenaChunk *first;   // Oldest chunk, where allocation restarts after a reset
+    ArenaChunk *current; // Chunk that allocations are bumped from
+    size_t chunk_size;   // Default capacity of newly added chunks
+} StringArena;
+
 // Define a struct to represent a list of Strings
 typedef struct {
     String *strings;
@@ -16,17 +182,218 @@ typedef struct {
     size_t capacity;
 } StringList;
 
+// Define a struct to represent a list of strings stored back to back in one buffer
+// Entry i spans bytes[offsets[i]] up to bytes[offsets[i + 1]]; offsets has size + 1 entries
+typedef struct {
+    char *bytes;
+    size_t bytes_used;
+    size_t bytes_capacity;
+    uint64_t *offsets;
+    size_t size;
+    size_t capacity; // Entries the offsets array has room for
+} PackedStringList;
+
+// Define a struct to represent a StringList with a hash index for O(1) lookup of distinct entries
+typedef struct {
+    StringList list;        // The entries; removals swap the last entry into the hole
+    uint64_t *hashes;       // Cached hash of each entry, parallel to list.strings
+    size_t hashes_capacity;
+    size_t *slots;          // Open-addressing table of entry index + 1, 0 marking an empty slot
+    size_t slot_count;      // Always a power of two
+} StringSet;
+
+// Define a struct to represent a pool of interned strings: equal strings share one stable copy
+typedef struct {
+    StringSet set;     // Entries point into arena, so their characters never move
+    StringArena arena;
+} StringInterner;
+
+// Define a struct to represent the lines of a memory-mapped file
+typedef struct {
+    char *map;          // Read-only mapping of the file, NULL if it was empty
+    size_t map_length;
+    StringView *lines;  // Views into map, without the "\n" or "\r\n" terminators
+    size_t count;
+} MappedLines;
+
+// Define a struct to represent a StringList snapshot file mapped back into memory
+// Entry i spans bytes[offsets[i]] up to the '\0' at bytes[offsets[i + 1] - 1]
+typedef struct {
+    char *map;               // Private mapping of the file, NULL if it could not be opened
+    size_t map_length;
+    const uint64_t *offsets; // size + 1 entries, inside map
+    char *bytes;             // Every entry with its terminator, inside map
+    size_t bytes_length;     // Length of bytes, from the header; no offset may point past it
+    size_t size;
+} MappedStringList;
+
+// Signature of the function stream_lines_mmap calls for every line
+typedef void (*LineCallback)(StringView line, void *context);
+
+// Signature of the work a ThreadPool hands out: run task number index of a job
+typedef void (*PoolTask)(void *context, size_t index);
+
+// Define a struct to represent a pool of worker threads that share the tasks of one job at a time
+// Tasks are claimed from a shared counter, so a thread that finishes early keeps taking work
+typedef struct {
+    pthread_t *threads;
+    size_t thread_count;
+    pthread_mutex_t run_lock;  // Held by the caller for the whole of a job
+    pthread_mutex_t lock;      // Guards the job fields below
+    pthread_cond_t work_ready; // Signalled when a job is posted or the pool stops
+    pthread_cond_t work_done;  // Signalled when the last worker leaves a job
+    PoolTask task;
+    void *context;
+    size_t task_count;
+    atomic_size_t next_task;
+    size_t workers_wanted;     // Workers that may still join the current job
+    size_t workers_busy;       // Workers running tasks of the current job
+    size_t generation;         // Bumped for every job so sleeping workers notice it
+    int stopping;
+} ThreadPool;
+
+// Signature of the operations string_list_map applies (to_lower_case, trim_string, ...)
+typedef String (*StringMapFn)(const String *str);
+
+// Signature of the predicates string_list_filter keeps entries by
+typedef int (*StringPredicate)(const String *str);
+
+// Outcome of the parse_* functions
+typedef enum {
+    PARSE_OK,       // A number was read; consumed says how many bytes it took
+    PARSE_INVALID,  // The input does not start with a number (or, for parse_column, is not only one)
+    PARSE_OVERFLOW  // The number is out of range; the value is clamped (infinity for doubles)
+} ParseStatus;
+
+// Define a struct to represent one fuzzy_find result
+typedef struct {
+    size_t index;    // Position of the entry in the list
+    size_t distance; // Edit distance between the entry and the query
+} FuzzyMatch;
+
+// Flags for compile_pattern
+#define PATTERN_CASE_INSENSITIVE 1 // Letters match either case, ASCII only
+
+// Define a struct to represent a glob compiled into a DFA over byte classes
+typedef struct {
+    int32_t *next;                 // Transitions, next[state * class_count + class]; NULL when the DFA grew too big
+    unsigned char *accepting;      // Whether each state means the input so far matches
+    unsigned char *settled;        // Whether each state goes back to itself on every byte, fixing the verdict
+    size_t state_count;            // State 0 is the start
+    size_t class_count;
+    unsigned char byte_class[256]; // Class of every byte; bytes the pattern treats alike share one
+    uint64_t *masks;               // Per class, the items taking its bytes, one bit per item
+    uint64_t *stars;               // The items that are a '*'
+    size_t positions;              // Number of items; being past the last one means a match
+    size_t words;                  // uint64_t words in one set of items
+    StringSearcher *literals;      // For a glob of only '*' and single bytes, its literals in order; NULL otherwise
+    size_t literal_count;
+    unsigned char anchored_start;  // The glob does not start with '*', so the first literal must start the input
+    unsigned char anchored_end;    // The glob does not end with '*', so the last literal must end the input
+} CompiledPattern;
+
+// Element types parse_column can produce
+typedef enum {
+    PARSE_I64,   // int64_t
+    PARSE_U64,   // uint64_t
+    PARSE_DOUBLE // double
+} ParseType;
+
+// Operations whose calls and bytes processed are counted (see Performance tracking)
+// Building with -DSTRING_TRACK_LATENCY samples their latencies too; -DSTRING_NO_TRACKING compiles every counter out
+enum {
+    STRING_OP_CREATE,
+    STRING_OP_COPY,
+    STRING_OP_SUBSTRING,
+    STRING_OP_CONCATENATE,
+    STRING_OP_JOIN,
+    STRING_OP_SPLIT,
+    STRING_OP_TOKENIZE,
+    STRING_OP_TRIM,
+    STRING_OP_REVERSE,
+    STRING_OP_UPPER_CASE,
+    STRING_OP_LOWER_CASE,
+    STRING_OP_TRANSFORM,
+    STRING_OP_ENCRYPT,
+    STRING_OP_PAD,
+    STRING_OP_REPLACE,
+    STRING_OP_REPLACE_MANY,
+    STRING_OP_FIND,
+    STRING_OP_FIND_ALL,
+    STRING_OP_COMPRESS,
+    STRING_OP_DECOMPRESS,
+    STRING_OP_FORMAT,
+    STRING_OP_SORT,
+    STRING_OP_LIST_ADD,
+    STRING_OP_LOAD_LINES,
+    STRING_OP_PARSE,
+    STRING_OP_FUZZY_FIND,
+    STRING_OP_LIST_SELECT,
+    STRING_OP_COUNT
+};
+
+// Latency histogram buckets: bucket b counts calls that took [2^b, 2^(b+1)) nanoseconds
+#define STRING_LATENCY_BUCKETS 40
+
+// Define a struct to hold the counters of one operation
+typedef struct {
+    size_t calls;
+    size_t bytes;                              // Input bytes processed
+    size_t latency[STRING_LATENCY_BUCKETS];    // log2 histogram of call latencies in nanoseconds, with STRING_TRACK_LATENCY
+} OperationStats;
+
 // Define a struct to track performance
 typedef struct {
-    size_t memory_used;
-    size_t operations;
+    size_t memory_used;   // Bytes allocated in total
+    size_t operations;    // Calls of every operation
+    size_t allocations;   // Number of allocations
+    size_t live_bytes;    // Bytes allocated and not yet released
+    size_t peak_bytes;    // Highest live_bytes seen, summed over threads
+    OperationStats ops[STRING_OP_COUNT];
 } PerformanceTracker;
 
+#ifndef STRING_NO_TRACKING
+// Define a struct to hold one thread's counters; only the owning thread writes them and
+// snapshot_performance merges every slot, so counting never makes threads wait on each other
+typedef struct TrackingSlot {
+    struct TrackingSlot *next;      // Every slot ever created
+    struct TrackingSlot *next_free; // Slots of exited threads, reused by new ones
+    atomic_size_t epoch;            // reset_performance generation the counters belong to
+    atomic_size_t allocations;
+    atomic_size_t allocated_bytes;
+    atomic_llong live_bytes;        // Signed: memory may be released by another thread than allocated it
+    atomic_llong peak_bytes;
+    atomic_size_t calls[STRING_OP_COUNT];
+    atomic_size_t bytes[STRING_OP_COUNT];
+    atomic_size_t latency[STRING_OP_COUNT][STRING_LATENCY_BUCKETS];
+} TrackingSlot;
+
+// Hooks the producers call; they expand to nothing under STRING_NO_TRACKING, except that
+// they still read their byte counts so locals and parameters kept only for them are not unused.
+// Only STRING_TRACK_LATENCY reads the clock, which costs more than most short operations.
+#ifdef STRING_TRACK_LATENCY
+#define STRING_TRACK_START(timer) uint64_t timer = tracking_clock()
+#define STRING_TRACK_STOP(timer, op, bytes) tracking_record((op), (timer), (bytes))
+#else
+#define STRING_TRACK_START(timer) ((void)0)
+#define STRING_TRACK_STOP(timer, op, bytes) tracking_count((op), (bytes))
+#endif
+#define STRING_TRACK_ALLOCATION(bytes) tracking_allocation(bytes)
+#define STRING_TRACK_RELEASE(bytes) tracking_release(bytes)
+#else
+#define STRING_TRACK_START(timer) ((void)0)
+#define STRING_TRACK_STOP(timer, op, bytes) ((void)(bytes))
+#define STRING_TRACK_ALLOCATION(bytes) ((void)(bytes))
+#define STRING_TRACK_RELEASE(bytes) ((void)(bytes))
+#endif
+
 
 // Function prototypes
+char *string_data(const String *str);
 String create_string(const char *initial_data);
 void free_string(String *str);
 size_t get_string_length(const String *str);
+size_t string_capacity(const String *str);
 String concatenate_strings(const String *str1, const String *str2);
 int compare_strings(const String *str1, const String *str2);
 void print_string(const String *str);
@@ -44,32 +411,137 @@ String capitalize(const String *str);
 StringList create_string_list();
 void add_string_to_list(StringList *list, const String *str);
 void remove_string_from_list(StringList *list, size_t index);
+void swap_remove_string_from_list(StringList *list, size_t index);
 void print_string_list(const StringList *list);
 void free_string_list(StringList *list);
+void sort_string_list(StringList *list, size_t nthreads);
+void unique_string_list(StringList *list);
+void string_list_map(StringList *list, StringMapFn op, size_t nthreads);
+void string_list_filter(StringList *list, StringPredicate predicate, size_t nthreads);
+
+// Thread pool
+ThreadPool *create_thread_pool(size_t nthreads);
+void thread_pool_run(ThreadPool *pool, PoolTask task, void *context, size_t task_count);
+void free_thread_pool(ThreadPool *pool);
+
+// PackedStringList operations
+PackedStringList create_packed_string_list(void);
+void packed_list_append(PackedStringList *list, StringView entry);
+void packed_list_append_string(PackedStringList *list, const String *str);
+StringView packed_list_get(const PackedStringList *list, size_t index);
+int packed_list_next(const PackedStringList *list, size_t *cursor, StringView *entry);
+PackedStringList packed_list_from_string_list(const StringList *list);
+StringList packed_list_to_string_list(const PackedStringList *list);
+void free_packed_string_list(PackedStringList *list);
+
+// Hashed StringSet and interning
+uint64_t hash_view(StringView view);
+StringSet create_string_set(void);
+size_t string_set_find(const StringSet *set, StringView entry);
+int string_set_contains(const StringSet *set, StringView entry);
+int string_set_insert_unique(StringSet *set, StringView entry);
+int string_set_remove(StringSet *set, StringView entry);
+void free_string_set(StringSet *set);
+StringInterner create_string_interner(void);
+StringView intern_string(StringInterner *interner, StringView str);
+void free_string_interner(StringInterner *interner);
+
+// Memory-mapped file ingest
+int load_lines_mmap(const char *path, MappedLines *lines);
+void free_mapped_lines(MappedLines *lines);
+int stream_lines_mmap(const char *path, size_t window_size, LineCallback callback, void *context);
+
+// StringList snapshots (binary file with an offsets table, mapped back without parsing)
+int save_string_list(const StringList *list, const char *path);
+MappedStringList open_string_list_mmap(const char *path);
+StringView mapped_string_list_get(const MappedStringList *list, size_t index);
+StringList mapped_string_list_to_string_list(const MappedStringList *list);
+int verify_mapped_string_list(const MappedStringList *list);
+void free_mapped_string_list(MappedStringList *list);
 
 // Performance tracking
 PerformanceTracker create_performance_tracker();
 void track_memory_usage(PerformanceTracker *tracker, size_t bytes);
 void track_operation(PerformanceTracker *tracker);
 void print_performance(const PerformanceTracker *tracker);
+PerformanceTracker snapshot_performance(void);
+void reset_performance(void);
+void print_performance_json(const PerformanceTracker *tracker, FILE *out);
+void print_performance_csv(const PerformanceTracker *tracker, FILE *out);
 
 // String compression and decompression
 String compress_string(const String *str);
 String decompress_string(const String *str);
 
+// Binary RLE codec (varint run lengths, literal runs, streaming mode)
+String rle_encode(StringView input);
+size_t rle_decoded_length(StringView encoded);
+RleEncoder create_rle_encoder(void);
+void rle_encoder_feed(RleEncoder *encoder, StringView chunk, StringBuilder *out);
+void rle_encoder_finish(RleEncoder *encoder, StringBuilder *out);
+RleDecoder create_rle_decoder(void);
+int rle_decoder_feed(RleDecoder *decoder, StringView chunk, StringBuilder *out);
+int rle_decoder_finish(const RleDecoder *decoder);
+
 // String encryption and decryption
 String encrypt_string(const String *str, int shift);
 String decrypt_string(const String *str, int shift);
 
 // String splitting
 String* split_string(const String *str, char delimiter, size_t *count);
+String* split_string_any(const String *str, const char *delimiters, size_t *count);
+void free_string_array(String *strings, size_t count);
+
+// Streaming tokenizer (chunked input, one token view at a time)
+StreamTokenizer create_stream_tokenizer(StringView delimiter, int flags);
+void tokenizer_feed(StreamTokenizer *tokenizer, StringView chunk);
+void tokenizer_finish(StreamTokenizer *tokenizer);
+int tokenizer_next(StreamTokenizer *tokenizer, StringView *token);
+void free_stream_tokenizer(StreamTokenizer *tokenizer);
 
 // Search and replace
 size_t search_substring(const String *str, const String *substr);
-String replace_substring(const String *str, const String *target, const String *replacement);
+String replace_substring_string(const String *str, const String *target, const String *replacement);
+String replace_substring_view(const String *str, StringView target, StringView replacement);
 
-// String formatting
+// Multi-pattern replacement (Aho-Corasick, one pass over the input)
+String replace_many(const String *str, const ReplacePair *pairs, size_t count);
+Replacer create_replacer(const ReplacePair *pairs, size_t count);
+String replacer_apply(const Replacer *replacer, const String *str);
+void free_replacer(Replacer *replacer);
+
+// String formatting (no length limit; integers and fixed-point numbers without printf)
 String format_string(const char *format, ...);
+String vformat_string(const char *format, va_list args);
+void builder_appendf(StringBuilder *builder, const char *format, ...);
+void builder_vappendf(StringBuilder *builder, const char *format, va_list args);
+void builder_append_uint(StringBuilder *builder, unsigned long long value);
+void builder_append_fixed(StringBuilder *builder, long long value, unsigned decimals);
+void builder_append_double(StringBuilder *builder, double value, unsigned decimals);
+
+// Numeric parsing (length-aware, with a status and the number of bytes consumed)
+ParseStatus parse_i64(StringView text, int64_t *value, size_t *consumed);
+ParseStatus parse_u64(StringView text, uint64_t *value, size_t *consumed);
+ParseStatus parse_double(StringView text, double *value, size_t *consumed);
+ParseStatus parse_column(const StringList *column, ParseType type, void *out, size_t *error_index);
+
+// UTF-8 (SIMD validation and code-point counting; substring and reverse that never split a code point)
+int is_ascii(StringView text);
+int utf8_validate(StringView text, size_t *error_offset);
+size_t utf8_count(StringView text);
+size_t get_string_utf8_length(const String *str);
+String utf8_substring(const String *str, size_t start, size_t length);
+String utf8_reverse_string(const String *str);
+
+// Edit distance and fuzzy search (bit-parallel Myers, prefiltered by length and shared bigrams)
+size_t edit_distance(StringView a, StringView b, size_t max_k);
+FuzzyMatch *fuzzy_find(const StringList *list, StringView query, size_t k, size_t nthreads, size_t *count);
+
+// Glob patterns (compiled once to a DFA over byte classes, matched without backtracking)
+CompiledPattern compile_pattern(const char *glob, int flags);
+int match_pattern(const CompiledPattern *pattern, StringView text);
+StringList string_list_select(const StringList *list, const CompiledPattern *pattern, size_t nthreads);
+void free_pattern(CompiledPattern *pattern);
 
 // String to integer and char array conversions
 int string_to_int(const String *str);
@@ -80,19 +552,175 @@ String char_array_to_string(const char *char_array);
 String pad_left(const String *str, size_t total_length, char pad_char);
 String pad_right(const String *str, size_t total_length, char pad_char);
 
+// String arena (bump allocation, released all at once)
+StringArena create_string_arena(size_t chunk_size);
+void *arena_alloc(StringArena *arena, size_t bytes);
+void arena_reset(StringArena *arena);
+void arena_free(StringArena *arena);
+
+// Arena variants of the String producers (a NULL arena allocates with malloc)
+String create_string_in(StringArena *arena, const char *initial_data);
+String copy_string_in(StringArena *arena, const String *str);
+String substring_in(StringArena *arena, const String *str, size_t start, size_t length);
+String concatenate_strings_in(StringArena *arena, const String *str1, const String *str2);
+String trim_string_in(StringArena *arena, const String *str);
+String reverse_string_in(StringArena *arena, const String *str);
+String to_upper_case_in(StringArena *arena, const String *str);
+String to_lower_case_in(StringArena *arena, const String *str);
+String pad_left_in(StringArena *arena, const String *str, size_t total_length, char pad_char);
+String pad_right_in(StringArena *arena, const String *str, size_t total_length, char pad_char);
+String* split_string_in(StringArena *arena, const String *str, char delimiter, size_t *count);
+
 // Uppercase and lowercase conversion
 String to_uppercase(const String *str);
 String to_lowercase(const String *str);
 
+// Byte transforms (one engine behind case mapping and the Caesar cipher)
+ByteMap compile_byte_map(const unsigned char table[256]);
+ByteMap upper_case_byte_map(void);
+ByteMap lower_case_byte_map(void);
+ByteMap caesar_byte_map(int shift);
+String transform_bytes(const String *str, const ByteMap *map);
+
+// In-place transforms (mutate the String, growing its storage only when the result needs it)
+void string_reserve(String *str, size_t capacity);
+void trim_string_inplace(String *str);
+void to_upper_case_inplace(String *str);
+void to_lower_case_inplace(String *str);
+void reverse_string_inplace(String *str);
+void encrypt_string_inplace(String *str, int shift);
+void decrypt_string_inplace(String *str, int shift);
+void transform_bytes_inplace(String *str, const ByteMap *map);
+size_t replace_substring_inplace(String *str, StringView target, StringView replacement);
+void pad_left_inplace(String *str, size_t total_length, char pad_char);
+void pad_right_inplace(String *str, size_t total_length, char pad_char);
+
+// Copy-on-write sharing (copies of a shared String take a reference instead of the characters)
+void share_string(String *str);
+size_t string_ref_count(const String *str);
+
 
 // Function to join an array of Strings into a single String with a delimiter
-String join_strings(const String *strings, size_t count, char delimiter);
+String join_strings(const String *strings, size_t count, const char *delimiter);
 
 // Function to tokenize a string by a delimiter, returns an array of Strings
 String* tokenize_string(const String *str, char delimiter, size_t *count);
 
+// String builder (amortized appends with geometric growth)
+StringBuilder create_string_builder(size_t capacity_hint);
+void builder_reserve(StringBuilder *builder, size_t additional);
+void builder_append_string(StringBuilder *builder, const String *str);
+void builder_append_cstr(StringBuilder *builder, const char *cstr);
+void builder_append_view(StringBuilder *builder, StringView view);
+void builder_append_char(StringBuilder *builder, char c);
+void builder_append_int(StringBuilder *builder, long long value);
+String builder_finish(StringBuilder *builder);
+void free_string_builder(StringBuilder *builder);
+
+// String views (zero-copy, never allocate except for the split_views array)
+StringView string_view(const String *str);
+StringView cstr_view(const char *cstr);
+String view_to_string(StringView view);
+String view_to_string_in(StringArena *arena, StringView view);
+StringView substring_view(StringView view, size_t start, size_t length);
+StringView trim_view(StringView view);
+StringView* split_views(StringView view, char delimiter, size_t *count);
+int compare_views(StringView view1, StringView view2);
+int views_equal(StringView view1, StringView view2);
+size_t find_view(StringView haystack, StringView needle);
+
+// Substring search engine (SIMD with runtime CPU dispatch, scalar fallback)
+size_t find_substring_from(const String *str, StringView needle, size_t from);
+size_t* find_all_substrings(const String *str, StringView needle, size_t *count);
+void free_match_offsets(size_t *matches, size_t count);
+StringSearcher create_searcher(StringView needle);
+size_t searcher_find(const StringSearcher *searcher, StringView haystack, size_t from);
+size_t* searcher_find_all(const StringSearcher *searcher, StringView haystack, size_t *count);
+void free_searcher(StringSearcher *searcher);
+
+// Parallel search over very large Strings
+size_t* parallel_find_all(const String *str, StringView needle, size_t nthreads, size_t *count);
+size_t parallel_count(const String *str, StringView needle, size_t nthreads);
+
+// Internal helpers shared by the producers
+static String string_alloc_in(StringArena *arena, size_t length);
+static String string_from_heap(char *data, size_t length, size_t capacity);
+static SearchKernel select_search_kernel(size_t needle_len);
+static size_t run_search_kernel(SearchKernel kernel, StringView haystack, StringView needle, size_t from);
+static void string_list_push(StringList *list, String str);
+static void *tracked_realloc(void *ptr, size_t old_bytes, size_t new_bytes);
+static void tracked_free(void *ptr, size_t bytes);
+static SharedBuffer *shared_buffer_of(const String *str);
+static void string_make_unique(String *str);
+static void string_release_shared(String *str);
+static size_t rle_decode_into(RleDecoder *decoder, StringView chunk, char *out);
+static String transform_bytes_in(StringArena *arena, const String *str, const ByteMap *map);
+static void apply_byte_map(const ByteMap *map, const char *src, char *dest, size_t length);
+static void run_parallel(size_t nthreads, PoolTask task, void *context, size_t task_count);
+static size_t builder_format(StringBuilder *builder, const char *format, va_list args);
+static char *format_u64(char *end, uint64_t value);
+static double scaled_product_error(double value, double factor, double scaled);
+#ifndef STRING_NO_TRACKING
+static void tracking_count(int op, size_t bytes);
+#ifdef STRING_TRACK_LATENCY
+static uint64_t tracking_clock(void);
+static void tracking_record(int op, uint64_t started, size_t bytes);
+#endif
+static void tracking_allocation(size_t bytes);
+static void tracking_release(size_t bytes);
+#endif
+
+#ifdef STRING_BENCHMARK
+// Benchmarks and self-checks (build with -DSTRING_BENCHMARK to run them instead of the demo)
+void benchmark_arena_split(void);
+void benchmark_join(void);
+void benchmark_sort(void);
+void benchmark_list_map(void);
+void benchmark_parallel_find(void);
+void benchmark_format(void);
+void benchmark_parse(void);
+void benchmark_utf8(void);
+void benchmark_shared(void);
+void benchmark_snapshot(void);
+void benchmark_fuzzy(void);
+void benchmark_pattern(void);
+void check_replace_many(void);
+void check_utf8(void);
+void check_shared_threads(void);
+void check_tokenizer(void);
+void check_rle(void);
+void check_replace_inplace(void);
+void benchmark_suite(FILE *out);
+#endif
+
 
 int main() {
+#ifdef STRING_BENCHMARK
+#ifdef STRING_BENCHMARK_SUITE
+    benchmark_suite(stdout);
+#else
+    check_replace_many();
+    check_utf8();
+    check_shared_threads();
+    check_tokenizer();
+    check_rle();
+    check_replace_inplace();
+    benchmark_arena_split();
+    benchmark_join();
+    benchmark_sort();
+    benchmark_list_map();
+    benchmark_parallel_find();
+    benchmark_format();
+    benchmark_parse();
+    benchmark_utf8();
+    benchmark_shared();
+    benchmark_snapshot();
+    benchmark_fuzzy();
+    benchmark_pattern();
+#endif
+    return 0;
+#endif
+
     // Example usage of string functions
     String str1 = create_string("Hello");
     String str2 = create_string(" World!");
@@ -127,33 +755,31 @@ int main() {
 
 
 
-// Function to create a new String
-String create_string(const char *initial_data) {
-    String str;
-    if (!initial_data) {
-        str.data = NULL;
-        str.length = 0;
-        return str;
-    }
-
-    str.length = strlen(initial_data);
-    str.data = (char *)malloc(str.length + 1); // +1 for null terminator
-    if (!str.data) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
+// Function to get the characters of a String, wherever they are stored
+char *string_data(const String *str) {
+    if (str->buf.storage == STRING_STORAGE_INLINE) {
+        return (char *)str->buf.inline_data;
     }
+    return str->buf.data;
+}
 
-    strcpy(str.data, initial_data);
-    return str;
+// Function to create a new String
+String create_string(const char *initial_data) {
+    return create_string_in(NULL, initial_data);
 }
 
 // Function to free the memory allocated for a String
 void free_string(String *str) {
-    if (str->data) {
-        free(str->data);
-        str->data = NULL;
-        str->length = 0;
-    }
+    if (str->buf.storage == STRING_STORAGE_HEAP && str->buf.data) {
+        STRING_TRACK_RELEASE(str->buf.capacity + 1);
+        free(str->buf.data);
+    } else if (str->buf.storage == STRING_STORAGE_SHARED) {
+        string_release_shared(str); // Frees the buffer only if this was its last owner
+    } // Arena storage is released by arena_reset/arena_free, inline storage needs nothing
+    str->buf.data = NULL;
+    str->length = 0;
+    str->buf.capacity = 0;
+    str->buf.storage = STRING_STORAGE_HEAP;
 }
 
 // Function to get the length of a String
@@ -161,33 +787,34 @@ size_t get_string_length(const String *str) {
     return str ? str->length : 0;
 }
 
+// Function to get how many characters a String can hold without growing, not counting the null terminator
+size_t string_capacity(const String *str) {
+    return str->buf.storage == STRING_STORAGE_INLINE ? STRING_SSO_CAPACITY : str->buf.capacity;
+}
+
 // Function to concatenate two Strings
 String concatenate_strings(const String *str1, const String *str2) {
     if (!str1 || !str2) return create_string(""); // Return empty string if invalid input
 
-    String result;
-    result.length = str1->length + str2->length;
-    result.data = (char *)malloc(result.length + 1); // +1 for null terminator
-    if (!result.data) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
-    }
-
-    strcpy(result.data, str1->data);
-    strcat(result.data, str2->data);
+    STRING_TRACK_START(started);
+    StringBuilder builder = create_string_builder(str1->length + str2->length);
+    builder_append_string(&builder, str1);
+    builder_append_string(&builder, str2);
+    String result = builder_finish(&builder);
+    STRING_TRACK_STOP(started, STRING_OP_CONCATENATE, result.length);
     return result;
 }
 
 // Function to compare two Strings
 int compare_strings(const String *str1, const String *str2) {
     if (!str1 || !str2) return -1; // Return invalid comparison if one of them is NULL
-    return strcmp(str1->data, str2->data);
+    return strcmp(string_data(str1), string_data(str2));
 }
 
 // Function to print a String
 void print_string(const String *str) {
-    if (str && str->data) {
-        printf("The string is: %s\n", str->data);
+    if (str && string_data(str)) {
+        printf("The string is: %s\n", string_data(str));
     } else {
         printf("(null)\n");
     }
@@ -195,86 +822,39 @@ void print_string(const String *str) {
 
 // Function to create a substring
 String substring(const String *str, size_t start, size_t length) {
-    if (!str || start >= str->length) return create_string(""); // Return empty string if out of range
-
-    size_t actual_length = (start + length > str->length) ? (str->length - start) : length;
-    String sub = create_string("");
-    sub.data = (char *)malloc(actual_length + 1); // +1 for null terminator
-    if (!sub.data) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
-    }
-    strncpy(sub.data, str->data + start, actual_length);
-    sub.data[actual_length] = '\0';
-    sub.length = actual_length;
-
-    return sub;
+    return substring_in(NULL, str, start, length);
 }
 
 // Function to find the index of a substring
 int find_substring(const String *str, const char *substr) {
     if (!str || !substr) return -1;
 
-    char *pos = strstr(str->data, substr);
-    return pos ? (int)(pos - str->data) : -1;
+    STRING_TRACK_START(started);
+    size_t pos = find_view(string_view(str), cstr_view(substr));
+    STRING_TRACK_STOP(started, STRING_OP_FIND, str->length);
+    return pos != STRING_NOT_FOUND ? (int)pos : -1;
 }
 
 // Function to replace all occurrences of a substring with another substring
 String replace_substring(const String *str, const char *old_sub, const char *new_sub) {
     if (!str || !old_sub || !new_sub) return create_string("");
 
-    String result = create_string(str->data);
-    char *pos;
-    while ((pos = strstr(result.data, old_sub))) {
-        size_t new_len = result.length - strlen(old_sub) + strlen(new_sub);
-        char *new_data = (char *)malloc(new_len + 1);
-        if (!new_data) {
-            fprintf(stderr, "Memory allocation failed\n");
-            exit(EXIT_FAILURE);
-        }
-        size_t prefix_len = pos - result.data;
-        strncpy(new_data, result.data, prefix_len);
-        strcpy(new_data + prefix_len, new_sub);
-        strcat(new_data + prefix_len + strlen(new_sub), pos + strlen(old_sub));
-        free(result.data);
-        result.data = new_data;
-        result.length = new_len;
-    }
-
-    return result;
+    return replace_substring_view(str, cstr_view(old_sub), cstr_view(new_sub));
 }
 
 // Function to trim leading and trailing spaces
 String trim_string(const String *str) {
-    if (!str || !str->data) return create_string("");
-
-    size_t start = 0, end = str->length - 1;
-    while (str->data[start] == ' ' && start <= end) start++;
-    while (str->data[end] == ' ' && end >= start) end--;
-
-    return substring(str, start, end - start + 1);
+    return trim_string_in(NULL, str);
 }
 
 // Function to convert a string to upper case
 String to_upper_case(const String *str) {
-    if (!str) return create_string("");
-    
-    String upper = create_string(str->data);
-    for (size_t i = 0; i < upper.length; i++) {
-        upper.data[i] = toupper(upper.data[i]);
-    }
-    return upper;
+    return to_upper_case_in(NULL, str);
 }
 
 // Function to convert a string to lower case
 String to_lower_case(const String *str) {
-    if (!str) return create_string("");
-
-    String lower = create_string(str->data);
-    for (size_t i = 0; i < lower.length; i++) {
-        lower.data[i] = tolower(lower.data[i]);
-    }
-    return lower;
+    return to_lower_case_in(NULL, str);
 }
 
 // Function to capitalize a string (first letter uppercase, rest lowercase)
@@ -283,7 +863,9 @@ String capitalize(const String *str) {
 
     String capitalized = to_lower_case(str);
     if (capitalized.length > 0) {
-        capitalized.data[0] = toupper(capitalized.data[0]);
+        ByteMap upper = upper_case_byte_map();
+        char *data = string_data(&capitalized);
+        apply_byte_map(&upper, data, data, 1);
     }
     return capitalized;
 }
@@ -295,28 +877,38 @@ StringList create_string_list() {
     StringList list;
     list.size = 0;
     list.capacity = 4; // Initial capacity
-    list.strings = (String *)malloc(list.capacity * sizeof(String));
-    if (!list.strings) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(EXIT_FAILURE);
-    }
+    list.strings = (String *)tracked_realloc(NULL, 0, list.capacity * sizeof(String));
     return list;
 }
 
 // Function to add a String to a StringList
 void add_string_to_list(StringList *list, const String *str) {
+    STRING_TRACK_START(started);
+    string_list_push(list, copy_string(str));
+    STRING_TRACK_STOP(started, STRING_OP_LIST_ADD, str->length);
+}
+
+// Function to move a String into a StringList without copying it; the list takes ownership
+static void string_list_push(StringList *list, String str) {
     if (list->size == list->capacity) {
+        list->strings = (String *)tracked_realloc(list->strings, list->capacity * sizeof(String), 2 * list->capacity * sizeof(String));
         list->capacity *= 2; // Double the capacity
-        list->strings = (String *)realloc(list->strings, list->capacity * sizeof(String));
-        if (!list->strings) {
-            fprintf(stderr, "Memory allocation failed\n");
-            exit(EXIT_FAILURE);
-        }
     }
-    list->strings[list->size] = copy_string(str);
+    list->strings[list->size] = str;
     list->size++;
 }
 
+// Function to remove a String from a StringList by moving the last String into its place, O(1)
+void swap_remove_string_from_list(StringList *list, size_t index) {
+    if (index >= list->size) {
+        fprintf(stderr, "Index out of bounds\n");
+        return;
+    }
+    free_string(&list->strings[index]);
+    list->strings[index] = list->strings[list->size - 1];
+    list->size--;
+}
+
 // Function to remove a String from a StringList by index
 void remove_string_from_list(StringList *list, size_t index) {
     if (index >= list->size) {
@@ -342,199 +934,1009 @@ void free_string_list(StringList *list) {
     for (size_t i = 0; i < list->size; i++) {
         free_string(&list->strings[i]);
     }
-    free(list->strings);
+    tracked_free(list->strings, list->capacity * sizeof(String));
 }
 
-// Performance tracking
+// StringList sorting
+//
+// sort_string_list orders entries by their bytes, shorter prefixes first, like compare_views.
+// Each entry gets a key caching the next 8 bytes of the string as a big-endian integer plus
+// how many bytes are left, so most comparisons are one integer compare that never touches
+// the string. Keys are distributed into 256 buckets by their first byte (MSD radix), and the
+// buckets are handed to worker threads and sorted with a multikey quicksort whose "characters"
+// are the 8-byte chunks: entries that tie on a chunk are re-keyed 8 bytes deeper. Data with a
+// common prefix (user:..., https://...) lands in one bucket, so with several threads any bucket
+// holding more than a 1 / (4 * nthreads) share of the list is split again, on the next cached
+// key byte and 8 bytes deeper once the cached chunk is used up, until its pieces are small
+// enough to spread over the threads.
 
-// Function to create a performance tracker
-PerformanceTracker create_performance_tracker() {
-    PerformanceTracker tracker = {0, 0};
-    return tracker;
-}
+// Buckets smaller than this are never split further, however many threads there are
+#define SORT_SPLIT_MIN 4096
 
-// Function to track memory usage
-void track_memory_usage(PerformanceTracker *tracker, size_t bytes) {
-    tracker->memory_used += bytes;
-}
+// Define a struct to represent a sort key for one StringList entry
+typedef struct {
+    uint64_t chunk; // Bytes [depth, depth + 8) of the string, big-endian, zero-padded
+    uint32_t tail;  // Bytes left from depth, clamped to 9 (meaning "more than this chunk")
+    uint32_t pad;
+    size_t index;   // Position of the entry in the unsorted list
+} SortKey;
 
-// Function to track an operation
-void track_operation(PerformanceTracker *tracker) {
-    tracker->operations++;
+// Define a struct to represent one range of keys a sorting thread sorts on its own
+typedef struct {
+    size_t start;
+    size_t count;
+    size_t depth; // Bytes every string in the range is known to share, where its keys were loaded
+} SortTask;
+
+// Define a struct to represent the work shared by the sorting threads
+typedef struct {
+    const String *strings;
+    SortKey *keys;
+    SortKey *scratch;      // As many keys again, for splitting buckets
+    size_t split_above;    // Buckets with more keys than this are split before sorting
+    SortTask *tasks;
+    size_t task_count;
+    size_t task_capacity;
+} SortJob;
+
+// Function to load the 8-byte chunk of a string starting at depth into a key
+static void load_sort_key(SortKey *key, const String *str, size_t depth) {
+    const unsigned char *data = (const unsigned char *)string_data(str);
+    size_t left = str->length > depth ? str->length - depth : 0;
+    uint64_t chunk = 0;
+    for (size_t i = 0; i < 8; i++) {
+        chunk = (chunk << 8) | (i < left ? data[depth + i] : 0);
+    }
+    key->chunk = chunk;
+    key->tail = (uint32_t)(left > 8 ? 9 : left);
 }
 
-// Function to print the performance statistics
-void print_performance(const PerformanceTracker *tracker) {
-    printf("Memory used: %zu bytes\n", tracker->memory_used);
-    printf("Operations: %zu\n", tracker->operations);
+// Function to order two keys on their cached chunk
+static int compare_sort_keys(const SortKey *a, const SortKey *b) {
+    if (a->chunk != b->chunk) return a->chunk < b->chunk ? -1 : 1;
+    return (a->tail > b->tail) - (a->tail < b->tail);
 }
 
+// Function to swap two keys
+static void swap_sort_keys(SortKey *a, SortKey *b) {
+    SortKey tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
 
-// Function to compress a string using run-length encoding
-String compress_string(const String *str) {
-    if (str->length == 0) return create_string(""); // Handle empty string
-    
-    char *compressed = (char *)malloc((2 * str->length) + 1); // Max size if no compression occurs
-    size_t index = 0, count;
-    
-    for (size_t i = 0; i < str->length; i++) {
-        compressed[index++] = str->data[i];
-        count = 1;
-        
-        while (i + 1 < str->length && str->data[i] == str->data[i + 1]) {
-            count++;
-            i++;
+// Function to multikey-quicksort keys whose strings are known to agree on their first depth bytes
+static void multikey_sort(const String *strings, SortKey *keys, size_t count, size_t depth) {
+    while (count > 1) {
+        if (count < 16) {
+            // Insertion sort on full comparisons for small ranges
+            for (size_t i = 1; i < count; i++) {
+                for (size_t j = i; j > 0; j--) {
+                    int order = compare_sort_keys(&keys[j - 1], &keys[j]);
+                    if (order == 0 && keys[j].tail == 9) {
+                        StringView a = substring_view(string_view(&strings[keys[j - 1].index]), depth, SIZE_MAX);
+                        StringView b = substring_view(string_view(&strings[keys[j].index]), depth, SIZE_MAX);
+                        order = compare_views(a, b);
+                    }
+                    if (order <= 0) break;
+                    swap_sort_keys(&keys[j - 1], &keys[j]);
+                }
+            }
+            return;
         }
-        index += sprintf(compressed + index, "%zu", count); // Append count after character
-    }
-    compressed[index] = '\0'; // Null-terminate compressed string
-    String result = {compressed, index};
-    return result;
-}
 
-// Function to decompress a run-length encoded string
-String decompress_string(const String *str) {
-    char *decompressed = (char *)malloc((str->length * 2) + 1); // Assume worst case expansion
-    size_t index = 0;
-    
-    for (size_t i = 0; i < str->length; i++) {
-        char ch = str->data[i];
-        i++;
-        
-        size_t count = 0;
-        while (i < str->length && isdigit(str->data[i])) {
-            count = count * 10 + (str->data[i] - '0');
-            i++;
+        // Ternary partition around the median of three chunks
+        SortKey *lo = &keys[0], *mid = &keys[count / 2], *hi = &keys[count - 1];
+        if (compare_sort_keys(lo, mid) > 0) swap_sort_keys(lo, mid);
+        if (compare_sort_keys(mid, hi) > 0) swap_sort_keys(mid, hi);
+        if (compare_sort_keys(lo, mid) > 0) swap_sort_keys(lo, mid);
+        SortKey pivot = *mid;
+
+        size_t lt = 0, i = 0, gt = count;
+        while (i < gt) {
+            int order = compare_sort_keys(&keys[i], &pivot);
+            if (order < 0) {
+                swap_sort_keys(&keys[lt++], &keys[i++]);
+            } else if (order > 0) {
+                swap_sort_keys(&keys[i], &keys[--gt]);
+            } else {
+                i++;
+            }
         }
-        i--; // Adjust since loop over-iterates
-        
-        for (size_t j = 0; j < count; j++) {
-            decompressed[index++] = ch;
+
+        // Entries equal on this chunk only need more sorting if they continue past it
+        if (pivot.tail == 9 && gt - lt > 1) {
+            for (size_t k = lt; k < gt; k++) {
+                load_sort_key(&keys[k], &strings[keys[k].index], depth + 8);
+            }
+            multikey_sort(strings, keys + lt, gt - lt, depth + 8);
         }
-    }
-    decompressed[index] = '\0'; // Null-terminate decompressed string
-    String result = {decompressed, index};
-    return result;
-}
 
-// Simple Caesar Cipher encryption with a shift key
-String encrypt_string(const String *str, int shift) {
-    String encrypted;
-    encrypted.length = str->length;
-    encrypted.data = (char *)malloc(encrypted.length + 1);
-    
-    for (size_t i = 0; i < str->length; i++) {
-        if (isalpha(str->data[i])) {
-            char offset = isupper(str->data[i]) ? 'A' : 'a';
-            encrypted.data[i] = ((str->data[i] - offset + shift) % 26) + offset;
+        // Recurse into the smaller side and loop on the larger one to bound the stack
+        if (lt < count - gt) {
+            multikey_sort(strings, keys, lt, depth);
+            keys += gt;
+            count -= gt;
         } else {
-            encrypted.data[i] = str->data[i]; // Non-alphabet characters remain unchanged
+            multikey_sort(strings, keys + gt, count - gt, depth);
+            count = lt;
         }
     }
-    encrypted.data[encrypted.length] = '\0'; // Null-terminate the encrypted string
-    return encrypted;
 }
 
-// Caesar Cipher decryption
-String decrypt_string(const String *str, int shift) {
-    return encrypt_string(str, 26 - (shift % 26)); // Decryption is just encryption with reverse shift
+// Function to add a range of keys to the sorting tasks
+static void add_sort_task(SortJob *job, size_t start, size_t count, size_t depth) {
+    if (job->task_count == job->task_capacity) {
+        job->tasks = (SortTask *)tracked_realloc(job->tasks, job->task_capacity * sizeof(SortTask),
+                                                 2 * job->task_capacity * sizeof(SortTask));
+        job->task_capacity *= 2; // Double the capacity
+    }
+    job->tasks[job->task_count].start = start;
+    job->tasks[job->task_count].count = count;
+    job->tasks[job->task_count].depth = depth;
+    job->task_count++;
 }
 
+// Function to cut a bucket whose keys agree on their first level bytes into sorting tasks,
+// splitting it by counting sort on the next key byte while it is bigger than split_above
+// Recurses only into the smaller pieces and loops on the largest, to bound the stack
+static void split_sort_bucket(SortJob *job, size_t start, size_t count, size_t depth, unsigned level) {
+    while (count >= 2) {
+        if (count <= job->split_above) {
+            add_sort_task(job, start, count, depth);
+            return;
+        }
+        SortKey *keys = job->keys + start;
 
-// Function to split a string by a delimiter, returns an array of Strings
-String* split_string(const String *str, char delimiter, size_t *count) {
-    size_t num_substrings = 1; // At least one substring
-    for (size_t i = 0; i < str->length; i++) {
-        if (str->data[i] == delimiter) num_substrings++;
-    }
+        if (level == 8) {
+            // The whole chunk is shared: order by how many bytes are left, and only the strings
+            // that continue past the chunk still need sorting, on keys loaded 8 bytes deeper
+            size_t counts[10] = {0};
+            for (size_t i = 0; i < count; i++) {
+                counts[keys[i].tail]++;
+            }
+            size_t fill[10];
+            for (size_t t = 0, sum = 0; t < 10; t++) {
+                fill[t] = sum;
+                sum += counts[t];
+            }
+            size_t shorter = fill[9]; // Strings that end within the chunk are equal within each tail
+            if (shorter > 0) {
+                for (size_t i = 0; i < count; i++) {
+                    job->scratch[start + fill[keys[i].tail]++] = keys[i];
+                }
+                memcpy(keys, job->scratch + start, count * sizeof(SortKey));
+            }
+            for (size_t i = shorter; i < count; i++) {
+                load_sort_key(&keys[i], &job->strings[keys[i].index], depth + 8);
+            }
+            start += shorter;
+            count -= shorter;
+            depth += 8;
+            level = 0;
+            continue;
+        }
 
-    String *result = (String *)malloc(num_substrings * sizeof(String));
-    size_t start = 0, idx = 0;
-    
-    for (size_t i = 0; i <= str->length; i++) {
-        if (str->data[i] == delimiter || i == str->length) {
-            size_t substr_len = i - start;
-            result[idx++] = substring(str, start, substr_len);
-            start = i + 1;
+        unsigned shift = 56 - 8 * level;
+        size_t counts[256] = {0};
+        for (size_t i = 0; i < count; i++) {
+            counts[(keys[i].chunk >> shift) & 0xFF]++;
+        }
+        size_t largest = 0;
+        for (size_t b = 1; b < 256; b++) {
+            if (counts[b] > counts[largest]) largest = b;
+        }
+        level++;
+        if (counts[largest] == count) continue; // Every key has the same byte here
+
+        size_t fill[256];
+        for (size_t b = 0, sum = 0; b < 256; b++) {
+            fill[b] = sum;
+            sum += counts[b];
+        }
+        size_t largest_start = start + fill[largest];
+        for (size_t i = 0; i < count; i++) {
+            job->scratch[start + fill[(keys[i].chunk >> shift) & 0xFF]++] = keys[i];
         }
+        memcpy(keys, job->scratch + start, count * sizeof(SortKey));
+        for (size_t b = 0, offset = start; b < 256; offset += counts[b], b++) {
+            if (b != largest) split_sort_bucket(job, offset, counts[b], depth, level);
+        }
+        start = largest_start;
+        count = counts[largest];
     }
-    *count = num_substrings;
-    return result;
 }
 
-// Function to reverse a string
-String reverse_string(const String *str) {
-    String reversed;
-    reversed.length = str->length;
-    reversed.data = (char *)malloc(reversed.length + 1);
-    
-    for (size_t i = 0; i < str->length; i++) {
-        reversed.data[i] = str->data[str->length - i - 1];
-    }
-    reversed.data[reversed.length] = '\0';
-    return reversed;
+// Function to sort one range of keys, a task of the sorting job
+static void sort_bucket_task(void *context, size_t task) {
+    SortJob *job = (SortJob *)context;
+    const SortTask *range = &job->tasks[task];
+    multikey_sort(job->strings, job->keys + range->start, range->count, range->depth);
 }
 
-// Function to search for a substring in a string
-size_t search_substring(const String *str, const String *substr) {
-    char *found = strstr(str->data, substr->data);
-    if (found) {
-        return found - str->data; // Return index of found substring
+// Function to sort a StringList by its bytes with a parallel MSD radix / multikey quicksort
+void sort_string_list(StringList *list, size_t nthreads) {
+    size_t count = list->size;
+    if (count < 2) return;
+    STRING_TRACK_START(sort_started);
+
+    SortJob job;
+    SortKey *keys = (SortKey *)tracked_realloc(NULL, 0, count * sizeof(SortKey));
+    SortKey *scattered = (SortKey *)tracked_realloc(NULL, 0, count * sizeof(SortKey));
+    String *sorted = (String *)tracked_realloc(NULL, 0, list->capacity * sizeof(String));
+    job.task_capacity = 256;
+    job.task_count = 0;
+    job.tasks = (SortTask *)tracked_realloc(NULL, 0, job.task_capacity * sizeof(SortTask));
+
+    // Key every entry and count the top-level buckets by first byte
+    size_t counts[256] = {0};
+    for (size_t i = 0; i < count; i++) {
+        load_sort_key(&keys[i], &list->strings[i], 0);
+        keys[i].pad = 0;
+        keys[i].index = i;
+        counts[keys[i].chunk >> 56]++;
+    }
+    size_t bucket_starts[257];
+    bucket_starts[0] = 0;
+    for (size_t b = 0; b < 256; b++) {
+        bucket_starts[b + 1] = bucket_starts[b] + counts[b];
+    }
+    size_t fill[256];
+    memcpy(fill, bucket_starts, sizeof(fill));
+    for (size_t i = 0; i < count; i++) {
+        scattered[fill[keys[i].chunk >> 56]++] = keys[i];
     }
-    return -1; // Return -1 if not found
-}
 
-// Function to replace all occurrences of a substring within a string with another substring
-String replace_substring(const String *str, const String *target, const String *replacement) {
-    size_t new_length = 0;
-    size_t target_len = target->length;
-    size_t replacement_len = replacement->length;
-    
-    // Calculate the size of the new string
-    const char *pos = str->data;
-    while ((pos = strstr(pos, target->data)) != NULL) {
-        new_length += replacement_len;
-        pos += target_len;
+    // Cut the buckets into tasks, splitting the ones too big to share out between the threads
+    job.strings = list->strings;
+    job.keys = scattered;
+    job.scratch = keys;
+    job.split_above = nthreads > 1 ? count / (4 * nthreads) : SIZE_MAX;
+    if (job.split_above < SORT_SPLIT_MIN) job.split_above = SORT_SPLIT_MIN;
+    for (size_t b = 0; b < 256; b++) {
+        split_sort_bucket(&job, bucket_starts[b], counts[b], 0, 1);
     }
-    new_length += str->length - (target_len * (new_length / replacement_len));
-    
-    char *new_data = (char *)malloc(new_length + 1);
-    char *dest = new_data;
-    const char *src = str->data;
-    
-    while ((pos = strstr(src, target->data)) != NULL) {
-        size_t len = pos - src;
-        memcpy(dest, src, len);
-        dest += len;
-        memcpy(dest, replacement->data, replacement_len);
-        dest += replacement_len;
-        src = pos + target_len;
+    tracked_free(keys, count * sizeof(SortKey));
+
+    // Sort the tasks, on the calling thread plus nthreads - 1 pool workers
+    run_parallel(nthreads, sort_bucket_task, &job, job.task_count);
+
+    // Move the entries into their sorted positions
+    for (size_t i = 0; i < count; i++) {
+        sorted[i] = list->strings[scattered[i].index];
     }
-    strcpy(dest, src); // Copy the rest of the string
-    return (String){new_data, new_length};
+    tracked_free(list->strings, list->capacity * sizeof(String));
+    list->strings = sorted;
+    tracked_free(scattered, count * sizeof(SortKey));
+    tracked_free(job.tasks, job.task_capacity * sizeof(SortTask));
+    STRING_TRACK_STOP(sort_started, STRING_OP_SORT, count);
 }
 
-// Function to format a string with placeholders
-String format_string(const char *format, ...) {
-    char buffer[1024]; // Static buffer, change to dynamic for larger strings
-    va_list args;
-    va_start(args, format);
-    vsnprintf(buffer, sizeof(buffer), format, args);
-    va_end(args);
-    
-    return create_string(buffer); // Return formatted string
-}
+// Function to remove adjacent duplicates in place, keeping the first of each run
+void unique_string_list(StringList *list) {
+    if (list->size < 2) return;
 
-// Function to convert a string to an integer (basic atoi implementation)
-int string_to_int(const String *str) {
-    return atoi(str->data); // Uses standard library function to convert string to integer
+    size_t kept = 1;
+    for (size_t i = 1; i < list->size; i++) {
+        if (views_equal(string_view(&list->strings[kept - 1]), string_view(&list->strings[i]))) {
+            free_string(&list->strings[i]);
+        } else {
+            list->strings[kept++] = list->strings[i];
+        }
+    }
+    list->size = kept;
+}
+
+// PackedStringList Operations
+
+// Function to create an empty PackedStringList
+PackedStringList create_packed_string_list(void) {
+    PackedStringList list;
+    list.size = 0;
+    list.capacity = 4; // Initial capacity
+    list.bytes_used = 0;
+    list.bytes_capacity = 64;
+    list.offsets = (uint64_t *)tracked_realloc(NULL, 0, (list.capacity + 1) * sizeof(uint64_t));
+    list.bytes = (char *)tracked_realloc(NULL, 0, list.bytes_capacity);
+    list.offsets[0] = 0;
+    return list;
+}
+
+// Function to append a copy of a view to a PackedStringList
+void packed_list_append(PackedStringList *list, StringView entry) {
+    if (list->size == list->capacity) {
+        list->offsets = (uint64_t *)tracked_realloc(list->offsets, (list->capacity + 1) * sizeof(uint64_t),
+                                                    (2 * list->capacity + 1) * sizeof(uint64_t));
+        list->capacity *= 2; // Double the capacity
+    }
+    if (list->bytes_used + entry.len > list->bytes_capacity) {
+        size_t capacity = list->bytes_capacity;
+        while (list->bytes_used + entry.len > capacity) {
+            capacity *= 2; // Double the capacity
+        }
+        list->bytes = (char *)tracked_realloc(list->bytes, list->bytes_capacity, capacity);
+        list->bytes_capacity = capacity;
+    }
+    if (entry.len) memcpy(list->bytes + list->bytes_used, entry.ptr, entry.len);
+    list->bytes_used += entry.len;
+    list->offsets[++list->size] = list->bytes_used;
+}
+
+// Function to append a copy of a String to a PackedStringList
+void packed_list_append_string(PackedStringList *list, const String *str) {
+    packed_list_append(list, string_view(str));
+}
+
+// Function to view an entry of a PackedStringList; the view is invalidated by the next append
+StringView packed_list_get(const PackedStringList *list, size_t index) {
+    StringView entry = {NULL, 0};
+    if (index >= list->size) {
+        fprintf(stderr, "Index out of bounds\n");
+        return entry;
+    }
+    entry.ptr = list->bytes + list->offsets[index];
+    entry.len = (size_t)(list->offsets[index + 1] - list->offsets[index]);
+    return entry;
+}
+
+// Function to step through a PackedStringList: start with *cursor = 0 and loop while it returns 1
+int packed_list_next(const PackedStringList *list, size_t *cursor, StringView *entry) {
+    if (*cursor >= list->size) return 0;
+    entry->ptr = list->bytes + list->offsets[*cursor];
+    entry->len = (size_t)(list->offsets[*cursor + 1] - list->offsets[*cursor]);
+    (*cursor)++;
+    return 1;
+}
+
+// Function to pack the entries of a StringList, sizing both buffers exactly
+PackedStringList packed_list_from_string_list(const StringList *list) {
+    PackedStringList packed;
+    packed.size = 0;
+    packed.capacity = list->size ? list->size : 4;
+    packed.bytes_used = 0;
+    packed.bytes_capacity = 0;
+    for (size_t i = 0; i < list->size; i++) {
+        packed.bytes_capacity += list->strings[i].length;
+    }
+    if (packed.bytes_capacity == 0) packed.bytes_capacity = 64;
+    packed.offsets = (uint64_t *)tracked_realloc(NULL, 0, (packed.capacity + 1) * sizeof(uint64_t));
+    packed.bytes = (char *)tracked_realloc(NULL, 0, packed.bytes_capacity);
+    packed.offsets[0] = 0;
+    for (size_t i = 0; i < list->size; i++) {
+        packed_list_append_string(&packed, &list->strings[i]);
+    }
+    return packed;
+}
+
+// Function to unpack a PackedStringList into a StringList of separate Strings
+StringList packed_list_to_string_list(const PackedStringList *list) {
+    StringList result = create_string_list();
+    StringView entry;
+    size_t cursor = 0;
+    while (packed_list_next(list, &cursor, &entry)) {
+        string_list_push(&result, view_to_string(entry));
+    }
+    return result;
+}
+
+// Function to free a PackedStringList
+void free_packed_string_list(PackedStringList *list) {
+    tracked_free(list->bytes, list->bytes_capacity);
+    tracked_free(list->offsets, (list->capacity + 1) * sizeof(uint64_t));
+    list->bytes = NULL;
+    list->offsets = NULL;
+    list->size = 0;
+    list->capacity = 0;
+    list->bytes_used = 0;
+    list->bytes_capacity = 0;
+}
+
+// Hashed StringSet
+//
+// The set keeps its entries in a plain StringList and indexes them with a linear-probing table
+// of entry positions. Each entry's hash is cached next to it, so probing compares hashes
+// first and growing the table never rehashes a string. Removal swaps the last entry into the
+// hole and closes the gap in the table by shifting later slots back, so no tombstones pile up.
+
+// Function to hash a view, 8 bytes per step with a multiply-xorshift mix
+uint64_t hash_view(StringView view) {
+    const unsigned char *p = (const unsigned char *)view.ptr;
+    size_t left = view.len;
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ (view.len * 0xFF51AFD7ED558CCDULL);
+    while (left >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        hash = (hash ^ word) * 0xBF58476D1CE4E5B9ULL;
+        hash ^= hash >> 31;
+        p += 8;
+        left -= 8;
+    }
+    if (left) {
+        uint64_t word = 0;
+        memcpy(&word, p, left);
+        hash = (hash ^ word) * 0xBF58476D1CE4E5B9ULL;
+        hash ^= hash >> 31;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Function to create an empty StringSet
+StringSet create_string_set(void) {
+    StringSet set;
+    set.list = create_string_list();
+    set.hashes_capacity = set.list.capacity;
+    set.hashes = (uint64_t *)tracked_realloc(NULL, 0, set.hashes_capacity * sizeof(uint64_t));
+    set.slot_count = 16;
+    set.slots = (size_t *)calloc(set.slot_count, sizeof(size_t));
+    if (!set.slots) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    STRING_TRACK_ALLOCATION(set.slot_count * sizeof(size_t));
+    return set;
+}
+
+// Function to find the table slot holding an entry, or the empty slot where it would go
+static size_t string_set_probe(const StringSet *set, StringView entry, uint64_t hash) {
+    size_t mask = set->slot_count - 1;
+    size_t slot = (size_t)hash & mask;
+    while (set->slots[slot]) {
+        size_t index = set->slots[slot] - 1;
+        if (set->hashes[index] == hash && views_equal(string_view(&set->list.strings[index]), entry)) break;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Function to double the table and reinsert every entry from its cached hash
+static void string_set_grow(StringSet *set) {
+    tracked_free(set->slots, set->slot_count * sizeof(size_t));
+    set->slot_count *= 2;
+    set->slots = (size_t *)calloc(set->slot_count, sizeof(size_t));
+    if (!set->slots) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    STRING_TRACK_ALLOCATION(set->slot_count * sizeof(size_t));
+    size_t mask = set->slot_count - 1;
+    for (size_t i = 0; i < set->list.size; i++) {
+        size_t slot = (size_t)set->hashes[i] & mask;
+        while (set->slots[slot]) slot = (slot + 1) & mask;
+        set->slots[slot] = i + 1;
+    }
+}
+
+// Function to add a String the set does not hold yet, taking ownership of it
+static void string_set_push(StringSet *set, String str, uint64_t hash, size_t slot) {
+    string_list_push(&set->list, str);
+    if (set->hashes_capacity < set->list.capacity) {
+        set->hashes = (uint64_t *)tracked_realloc(set->hashes, set->hashes_capacity * sizeof(uint64_t),
+                                                  set->list.capacity * sizeof(uint64_t));
+        set->hashes_capacity = set->list.capacity;
+    }
+    set->hashes[set->list.size - 1] = hash;
+    set->slots[slot] = set->list.size;
+    if (set->list.size * 4 > set->slot_count * 3) string_set_grow(set); // Keep the load factor under 3/4
+}
+
+// Function to get the position of an entry in set->list, or STRING_NOT_FOUND
+size_t string_set_find(const StringSet *set, StringView entry) {
+    size_t slot = string_set_probe(set, entry, hash_view(entry));
+    return set->slots[slot] ? set->slots[slot] - 1 : STRING_NOT_FOUND;
+}
+
+// Function to check whether a set holds an entry
+int string_set_contains(const StringSet *set, StringView entry) {
+    return string_set_find(set, entry) != STRING_NOT_FOUND;
+}
+
+// Function to add a copy of an entry unless the set already holds it; returns 1 if it was added
+int string_set_insert_unique(StringSet *set, StringView entry) {
+    uint64_t hash = hash_view(entry);
+    size_t slot = string_set_probe(set, entry, hash);
+    if (set->slots[slot]) return 0;
+
+    string_set_push(set, view_to_string(entry), hash, slot);
+    return 1;
+}
+
+// Function to remove an entry in O(1); the last entry of set->list moves into its position
+int string_set_remove(StringSet *set, StringView entry) {
+    size_t mask = set->slot_count - 1;
+    size_t hole = string_set_probe(set, entry, hash_view(entry));
+    if (!set->slots[hole]) return 0;
+    size_t index = set->slots[hole] - 1;
+
+    // Shift later slots of the probe run back so lookups never stop at the hole
+    for (size_t slot = (hole + 1) & mask; set->slots[slot]; slot = (slot + 1) & mask) {
+        size_t home = (size_t)set->hashes[set->slots[slot] - 1] & mask;
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            set->slots[hole] = set->slots[slot];
+            hole = slot;
+        }
+    }
+    set->slots[hole] = 0;
+
+    // Point the slot of the last entry at the position it is about to move to
+    size_t last = set->list.size - 1;
+    if (index != last) {
+        size_t slot = (size_t)set->hashes[last] & mask;
+        while (set->slots[slot] != last + 1) slot = (slot + 1) & mask;
+        set->slots[slot] = index + 1;
+        set->hashes[index] = set->hashes[last];
+    }
+    swap_remove_string_from_list(&set->list, index);
+    return 1;
+}
+
+// Function to free a StringSet and its entries
+void free_string_set(StringSet *set) {
+    free_string_list(&set->list);
+    tracked_free(set->hashes, set->hashes_capacity * sizeof(uint64_t));
+    tracked_free(set->slots, set->slot_count * sizeof(size_t));
+    set->hashes = NULL;
+    set->slots = NULL;
+    set->hashes_capacity = 0;
+    set->slot_count = 0;
+}
+
+// String interning
+
+// Function to create an empty StringInterner
+StringInterner create_string_interner(void) {
+    StringInterner interner;
+    interner.set = create_string_set();
+    interner.arena = create_string_arena(0);
+    return interner;
+}
+
+// Function to intern a string: equal strings get the same, null-terminated ptr for the
+// interner's lifetime, so interned views can be compared with ptr == ptr
+StringView intern_string(StringInterner *interner, StringView str) {
+    uint64_t hash = hash_view(str);
+    size_t slot = string_set_probe(&interner->set, str, hash);
+    if (!interner->set.slots[slot]) {
+        // Always store the characters in the arena, never inline, so they stay put as the list grows
+        String copy;
+        copy.buf.data = (char *)arena_alloc(&interner->arena, str.len + 1);
+        if (str.len) memcpy(copy.buf.data, str.ptr, str.len);
+        copy.buf.data[str.len] = '\0';
+        copy.length = str.len;
+        copy.buf.capacity = str.len;
+        copy.buf.storage = STRING_STORAGE_ARENA;
+        string_set_push(&interner->set, copy, hash, slot);
+        slot = string_set_probe(&interner->set, str, hash); // The table may have grown
+    }
+    return string_view(&interner->set.list.strings[interner->set.slots[slot] - 1]);
+}
+
+// Function to free a StringInterner; every view it returned becomes invalid
+void free_string_interner(StringInterner *interner) {
+    free_string_set(&interner->set);
+    arena_free(&interner->arena);
+}
+
+// Performance tracking
+//
+// Every producer counts its calls and the bytes it processed into counters that belong to the
+// calling thread, and String storage, builder buffers and arena chunks count their allocations
+// the same way. Built with -DSTRING_TRACK_LATENCY, producers also read the clock around every
+// call and add its latency to a log2 histogram; that is off by default because two clock reads
+// cost several times more than a short operation such as create_string or find_substring. Nothing is shared on the hot path: snapshot_performance
+// merges the slots of every thread when the numbers are read. Calls made from inside other
+// operations (the copy in add_string_to_list, say) are counted for both. Peak bytes are the
+// sum of each thread's peak, an upper bound when threads peak at different times.
+
+// Names of the STRING_OP_* operations, as they appear in the printed and exported statistics
+static const char *const string_op_names[STRING_OP_COUNT] = {
+    "create_string", "copy_string", "substring", "concatenate_strings", "join_strings",
+    "split_string", "tokenize_string", "trim_string", "reverse_string", "to_upper_case",
+    "to_lower_case", "transform_bytes", "encrypt_string", "pad_string", "replace_substring",
+    "replace_many", "find_substring", "find_all_substrings", "compress_string",
+    "decompress_string", "format_string", "sort_string_list", "add_string_to_list",
+    "load_lines_mmap", "parse_column", "fuzzy_find",
+    "string_list_select"
+};
+
+#ifndef STRING_NO_TRACKING
+static pthread_mutex_t tracking_lock = PTHREAD_MUTEX_INITIALIZER; // Guards the slot lists below
+static TrackingSlot *tracking_slots;      // Every slot ever created
+static TrackingSlot *tracking_free_slots; // Slots left behind by exited threads
+static pthread_key_t tracking_key;        // Hands a thread's slot back when it exits
+static pthread_once_t tracking_once = PTHREAD_ONCE_INIT;
+static atomic_size_t tracking_epoch;      // Bumped by reset_performance
+static _Thread_local TrackingSlot *tracking_slot;
+
+// Function to return an exited thread's slot for reuse; its counts stay part of every snapshot
+static void tracking_thread_exit(void *slot) {
+    pthread_mutex_lock(&tracking_lock);
+    ((TrackingSlot *)slot)->next_free = tracking_free_slots;
+    tracking_free_slots = (TrackingSlot *)slot;
+    pthread_mutex_unlock(&tracking_lock);
+}
+
+// Function to create the key whose destructor recycles slots
+static void tracking_init(void) {
+    pthread_key_create(&tracking_key, tracking_thread_exit);
+}
+
+// Function to add to a counter only the calling thread writes, without a locked instruction
+static void tracking_add(atomic_size_t *counter, size_t amount) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+// Function to start a slot over for a new reset_performance generation; live bytes carry over
+static void tracking_clear(TrackingSlot *slot, size_t epoch) {
+    atomic_store_explicit(&slot->allocations, 0, memory_order_relaxed);
+    atomic_store_explicit(&slot->allocated_bytes, 0, memory_order_relaxed);
+    atomic_store_explicit(&slot->peak_bytes, atomic_load_explicit(&slot->live_bytes, memory_order_relaxed), memory_order_relaxed);
+    for (size_t op = 0; op < STRING_OP_COUNT; op++) {
+        atomic_store_explicit(&slot->calls[op], 0, memory_order_relaxed);
+        atomic_store_explicit(&slot->bytes[op], 0, memory_order_relaxed);
+        for (size_t b = 0; b < STRING_LATENCY_BUCKETS; b++) {
+            atomic_store_explicit(&slot->latency[op][b], 0, memory_order_relaxed);
+        }
+    }
+    atomic_store_explicit(&slot->epoch, epoch, memory_order_relaxed);
+}
+
+// Function to get the calling thread's slot, claiming one the first time the thread counts something
+static TrackingSlot *tracking_current(void) {
+    TrackingSlot *slot = tracking_slot;
+    if (!slot) {
+        pthread_once(&tracking_once, tracking_init);
+        pthread_mutex_lock(&tracking_lock);
+        slot = tracking_free_slots;
+        if (slot) {
+            tracking_free_slots = slot->next_free;
+        } else {
+            slot = (TrackingSlot *)calloc(1, sizeof(TrackingSlot));
+            if (!slot) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+            slot->next = tracking_slots;
+            tracking_slots = slot;
+        }
+        pthread_mutex_unlock(&tracking_lock);
+        pthread_setspecific(tracking_key, slot);
+        tracking_slot = slot;
+    }
+    size_t epoch = atomic_load_explicit(&tracking_epoch, memory_order_relaxed);
+    if (atomic_load_explicit(&slot->epoch, memory_order_relaxed) != epoch) {
+        tracking_clear(slot, epoch);
+    }
+    return slot;
+}
+
+// Function to count one call of an operation and the bytes it processed
+static void tracking_count(int op, size_t bytes) {
+    TrackingSlot *slot = tracking_current();
+    tracking_add(&slot->calls[op], 1);
+    tracking_add(&slot->bytes[op], bytes);
+}
+
+#ifdef STRING_TRACK_LATENCY
+// Function to read the monotonic clock in nanoseconds
+static uint64_t tracking_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+// Function to count one call of an operation that started at the given clock reading, with its latency
+static void tracking_record(int op, uint64_t started, size_t bytes) {
+    uint64_t elapsed = tracking_clock() - started;
+    size_t bucket = 0;
+    while (elapsed >>= 1) bucket++; // floor(log2(elapsed))
+    if (bucket >= STRING_LATENCY_BUCKETS) bucket = STRING_LATENCY_BUCKETS - 1;
+
+    tracking_count(op, bytes);
+    tracking_add(&tracking_current()->latency[op][bucket], 1);
+}
+#endif
+
+// Function to count an allocation of the given size
+static void tracking_allocation(size_t bytes) {
+    TrackingSlot *slot = tracking_current();
+    tracking_add(&slot->allocations, 1);
+    tracking_add(&slot->allocated_bytes, bytes);
+    long long live = atomic_load_explicit(&slot->live_bytes, memory_order_relaxed) + (long long)bytes;
+    atomic_store_explicit(&slot->live_bytes, live, memory_order_relaxed);
+    if (live > atomic_load_explicit(&slot->peak_bytes, memory_order_relaxed)) {
+        atomic_store_explicit(&slot->peak_bytes, live, memory_order_relaxed);
+    }
+}
+
+// Function to count the release of an allocation of the given size
+static void tracking_release(size_t bytes) {
+    TrackingSlot *slot = tracking_current();
+    long long live = atomic_load_explicit(&slot->live_bytes, memory_order_relaxed) - (long long)bytes;
+    atomic_store_explicit(&slot->live_bytes, live, memory_order_relaxed);
+}
+#endif
+
+// Function to create a performance tracker
+PerformanceTracker create_performance_tracker() {
+    PerformanceTracker tracker;
+    memset(&tracker, 0, sizeof(tracker));
+    return tracker;
+}
+
+// Function to merge the counters of every thread into a tracker
+// Returns all zeros when built with STRING_NO_TRACKING
+PerformanceTracker snapshot_performance(void) {
+    PerformanceTracker tracker = create_performance_tracker();
+#ifndef STRING_NO_TRACKING
+    size_t epoch = atomic_load_explicit(&tracking_epoch, memory_order_relaxed);
+    long long live = 0, peak = 0;
+    pthread_mutex_lock(&tracking_lock);
+    for (TrackingSlot *slot = tracking_slots; slot; slot = slot->next) {
+        long long slot_live = atomic_load_explicit(&slot->live_bytes, memory_order_relaxed);
+        live += slot_live;
+        if (atomic_load_explicit(&slot->epoch, memory_order_relaxed) != epoch) {
+            peak += slot_live; // Not touched since the last reset, so it only holds what was live then
+            continue;
+        }
+        peak += atomic_load_explicit(&slot->peak_bytes, memory_order_relaxed);
+        tracker.allocations += atomic_load_explicit(&slot->allocations, memory_order_relaxed);
+        tracker.memory_used += atomic_load_explicit(&slot->allocated_bytes, memory_order_relaxed);
+        for (size_t op = 0; op < STRING_OP_COUNT; op++) {
+            tracker.ops[op].calls += atomic_load_explicit(&slot->calls[op], memory_order_relaxed);
+            tracker.ops[op].bytes += atomic_load_explicit(&slot->bytes[op], memory_order_relaxed);
+            for (size_t b = 0; b < STRING_LATENCY_BUCKETS; b++) {
+                tracker.ops[op].latency[b] += atomic_load_explicit(&slot->latency[op][b], memory_order_relaxed);
+            }
+        }
+    }
+    pthread_mutex_unlock(&tracking_lock);
+
+    for (size_t op = 0; op < STRING_OP_COUNT; op++) {
+        tracker.operations += tracker.ops[op].calls;
+    }
+    tracker.live_bytes = live > 0 ? (size_t)live : 0;
+    tracker.peak_bytes = peak > 0 ? (size_t)peak : 0;
+#endif
+    return tracker;
+}
+
+// Function to zero the call, byte and allocation counters of every thread; live bytes are kept
+void reset_performance(void) {
+#ifndef STRING_NO_TRACKING
+    atomic_fetch_add_explicit(&tracking_epoch, 1, memory_order_relaxed); // Each thread clears its own slot on its next count
+#endif
+}
+
+// Function to track memory usage
+void track_memory_usage(PerformanceTracker *tracker, size_t bytes) {
+    tracker->memory_used += bytes;
+}
+
+// Function to track an operation
+void track_operation(PerformanceTracker *tracker) {
+    tracker->operations++;
+}
+
+// Function to estimate a latency percentile (0 to 1) as the upper bound of the histogram bucket it falls in
+// samples is the histogram's total, which is nonzero only when built with STRING_TRACK_LATENCY
+static double latency_percentile(const OperationStats *stats, size_t samples, double fraction) {
+    size_t rank = (size_t)(fraction * (double)(samples - 1)), seen = 0;
+    for (size_t b = 0; b < STRING_LATENCY_BUCKETS; b++) {
+        seen += stats->latency[b];
+        if (seen > rank) return (double)(2ULL << b);
+    }
+    return (double)(2ULL << (STRING_LATENCY_BUCKETS - 1));
+}
+
+// Function to print the performance statistics
+void print_performance(const PerformanceTracker *tracker) {
+    printf("Memory used: %zu bytes\n", tracker->memory_used);
+    printf("Operations: %zu\n", tracker->operations);
+    printf("Allocations: %zu (live %zu bytes, peak %zu bytes)\n", tracker->allocations, tracker->live_bytes, tracker->peak_bytes);
+    for (size_t op = 0; op < STRING_OP_COUNT; op++) {
+        const OperationStats *stats = &tracker->ops[op];
+        if (stats->calls == 0) continue;
+        size_t samples = 0;
+        for (size_t b = 0; b < STRING_LATENCY_BUCKETS; b++) {
+            samples += stats->latency[b];
+        }
+        printf("  %-20s %10zu calls %14zu bytes", string_op_names[op], stats->calls, stats->bytes);
+        if (samples) {
+            printf("  p50 <%.0f ns  p99 <%.0f ns", latency_percentile(stats, samples, 0.5),
+                   latency_percentile(stats, samples, 0.99));
+        }
+        printf("\n");
+    }
+}
+
+// Function to write the performance statistics as one JSON object
+// Each operation's "latency_log2_ns" array holds the calls that took [2^i, 2^(i+1)) nanoseconds,
+// all zeros unless built with STRING_TRACK_LATENCY
+void print_performance_json(const PerformanceTracker *tracker, FILE *out) {
+    fprintf(out, "{\"memory_used\":%zu,\"operations\":%zu,\"allocations\":%zu,\"live_bytes\":%zu,\"peak_bytes\":%zu,\"ops\":{",
+            tracker->memory_used, tracker->operations, tracker->allocations, tracker->live_bytes, tracker->peak_bytes);
+    for (size_t op = 0; op < STRING_OP_COUNT; op++) {
+        const OperationStats *stats = &tracker->ops[op];
+        fprintf(out, "%s\"%s\":{\"calls\":%zu,\"bytes\":%zu,\"latency_log2_ns\":[", op ? "," : "",
+                string_op_names[op], stats->calls, stats->bytes);
+        for (size_t b = 0; b < STRING_LATENCY_BUCKETS; b++) {
+            fprintf(out, "%s%zu", b ? "," : "", stats->latency[b]);
+        }
+        fprintf(out, "]}");
+    }
+    fprintf(out, "}}\n");
+}
+
+// Function to write the performance statistics as CSV rows of metric,operation,bucket,value
+// Memory rows leave operation and bucket empty; latency rows count the calls that took [2^bucket, 2^(bucket+1)) ns
+// and appear only when built with STRING_TRACK_LATENCY
+void print_performance_csv(const PerformanceTracker *tracker, FILE *out) {
+    fprintf(out, "metric,operation,bucket,value\n");
+    fprintf(out, "memory_used,,,%zu\n", tracker->memory_used);
+    fprintf(out, "operations,,,%zu\n", tracker->operations);
+    fprintf(out, "allocations,,,%zu\n", tracker->allocations);
+    fprintf(out, "live_bytes,,,%zu\n", tracker->live_bytes);
+    fprintf(out, "peak_bytes,,,%zu\n", tracker->peak_bytes);
+    for (size_t op = 0; op < STRING_OP_COUNT; op++) {
+        const OperationStats *stats = &tracker->ops[op];
+        fprintf(out, "calls,%s,,%zu\n", string_op_names[op], stats->calls);
+        fprintf(out, "bytes,%s,,%zu\n", string_op_names[op], stats->bytes);
+        for (size_t b = 0; b < STRING_LATENCY_BUCKETS; b++) {
+            if (stats->latency[b]) fprintf(out, "latency_log2_ns,%s,%zu,%zu\n", string_op_names[op], b, stats->latency[b]);
+        }
+    }
+}
+
+
+// Function to compress a string using run-length encoding (see the RLE codec section for the format)
+String compress_string(const String *str) {
+    STRING_TRACK_START(started);
+    String result = rle_encode(string_view(str));
+    STRING_TRACK_STOP(started, STRING_OP_COMPRESS, str->length);
+    return result;
+}
+
+// Function to decompress a run-length encoded string; invalid input, or input that would decode
+// to more than RLE_MAX_DECODED bytes, gives an empty string
+String decompress_string(const String *str) {
+    StringView encoded = string_view(str);
+    size_t length = rle_decoded_length(encoded);
+    if (length == STRING_NOT_FOUND || length > RLE_MAX_DECODED) {
+        fprintf(stderr, "Invalid compressed data\n");
+        return create_string("");
+    }
+
+    STRING_TRACK_START(started);
+    String result = string_alloc_in(NULL, length); // Exact size, computed before allocating
+    RleDecoder decoder = create_rle_decoder();
+    rle_decode_into(&decoder, encoded, string_data(&result));
+    STRING_TRACK_STOP(started, STRING_OP_DECOMPRESS, encoded.len);
+    return result;
+}
+
+// Simple Caesar Cipher encryption with a shift key
+String encrypt_string(const String *str, int shift) {
+    STRING_TRACK_START(started);
+    ByteMap map = caesar_byte_map(shift); // Non-alphabet characters remain unchanged
+    String result = transform_bytes(str, &map);
+    STRING_TRACK_STOP(started, STRING_OP_ENCRYPT, result.length);
+    return result;
+}
+
+// Caesar Cipher decryption
+String decrypt_string(const String *str, int shift) {
+    return encrypt_string(str, 26 - (shift % 26)); // Decryption is just encryption with reverse shift
+}
+
+
+// Function to split a string by a delimiter, returns an array of Strings
+String* split_string(const String *str, char delimiter, size_t *count) {
+    return split_string_in(NULL, str, delimiter, count);
+}
+
+// Function to free an array returned by split_string, split_string_any or tokenize_string, and its Strings
+void free_string_array(String *strings, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free_string(&strings[i]);
+    }
+    tracked_free(strings, count * sizeof(String));
+}
+
+// Function to reverse a string
+String reverse_string(const String *str) {
+    return reverse_string_in(NULL, str);
+}
+
+// Function to search for a substring in a string
+size_t search_substring(const String *str, const String *substr) {
+    STRING_TRACK_START(started);
+    size_t pos = find_view(string_view(str), string_view(substr)); // STRING_NOT_FOUND ((size_t)-1) if not found
+    STRING_TRACK_STOP(started, STRING_OP_FIND, str->length);
+    return pos;
+}
+
+// Function to replace all occurrences of a substring within a string with another substring
+String replace_substring_string(const String *str, const String *target, const String *replacement) {
+    if (!str || !target || !replacement) return create_string("");
+
+    return replace_substring_view(str, string_view(target), string_view(replacement));
+}
+
+// Function to replace all non-overlapping occurrences of target, scanning left to right
+// A counting pass sizes the result exactly, a second pass writes it; an empty target replaces nothing
+String replace_substring_view(const String *str, StringView target, StringView replacement) {
+    if (target.len == 0) return copy_string(str);
+
+    STRING_TRACK_START(started);
+    StringView source = string_view(str);
+    SearchKernel kernel = select_search_kernel(target.len);
+
+    // Calculate the size of the new string
+    size_t matches = 0;
+    for (size_t pos = run_search_kernel(kernel, source, target, 0); pos != STRING_NOT_FOUND;
+         pos = run_search_kernel(kernel, source, target, pos + target.len)) {
+        matches++;
+    }
+    if (matches == 0) {
+        String copy = copy_string(str);
+        STRING_TRACK_STOP(started, STRING_OP_REPLACE, source.len);
+        return copy;
+    }
+
+    String result = string_alloc_in(NULL, source.len - matches * target.len + matches * replacement.len);
+    char *dest = string_data(&result);
+    size_t src = 0;
+    for (size_t pos = run_search_kernel(kernel, source, target, 0); pos != STRING_NOT_FOUND;
+         pos = run_search_kernel(kernel, source, target, pos + target.len)) {
+        memcpy(dest, source.ptr + src, pos - src);
+        dest += pos - src;
+        if (replacement.len) memcpy(dest, replacement.ptr, replacement.len);
+        dest += replacement.len;
+        src = pos + target.len;
+    }
+    memcpy(dest, source.ptr + src, source.len - src); // Copy the rest of the string
+    STRING_TRACK_STOP(started, STRING_OP_REPLACE, source.len);
+    return result;
+}
+
+// Function to format a string with placeholders
+String format_string(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    String result = vformat_string(format, args);
+    va_end(args);
+    return result; // Return formatted string
+}
+
+// Function to format a string from a va_list, however long the result is
+String vformat_string(const char *format, va_list args) {
+    STRING_TRACK_START(started);
+    StringBuilder builder = create_string_builder(0);
+    builder_format(&builder, format, args);
+    String result = builder_finish(&builder);
+    STRING_TRACK_STOP(started, STRING_OP_FORMAT, result.length);
+    return result;
+}
+
+// Function to convert a string to an integer like atoi, clamping instead of overflowing
+int string_to_int(const String *str) {
+    StringView view = string_view(str);
+    while (view.len && isspace((unsigned char)view.ptr[0])) { // Leading whitespace is skipped, as atoi did
+        view.ptr++;
+        view.len--;
+    }
+    int64_t value;
+    parse_i64(view, &value, NULL);
+    return value > INT_MAX ? INT_MAX : value < INT_MIN ? INT_MIN : (int)value; // Clamped instead of undefined
 }
 
 // Function to return an array of chars from a String
 char* string_to_char_array(const String *str) {
     char *char_array = (char *)malloc(str->length + 1);
     if (char_array) {
-        strcpy(char_array, str->data); // Copy the string data to the array
+        strcpy(char_array, string_data(str)); // Copy the string data to the array
     }
     return char_array;
 }
@@ -546,113 +1948,5518 @@ String char_array_to_string(const char *char_array) {
 
 // Function to pad a string on the left to a specific length with a character
 String pad_left(const String *str, size_t total_length, char pad_char) {
-    if (str->length >= total_length) {
-        return create_string(str->data); // No padding needed
-    }
-    
-    String result;
-    result.length = total_length;
-    result.data = (char *)malloc(total_length + 1); // Allocate new memory
-    if (result.data) {
-        size_t pad_size = total_length - str->length;
-        memset(result.data, pad_char, pad_size); // Fill with padding characters
-        strcpy(result.data + pad_size, str->data); // Copy original string
-    }
-    return result;
+    return pad_left_in(NULL, str, total_length, pad_char);
 }
 
 // Function to pad a string on the right
 String pad_right(const String *str, size_t total_length, char pad_char) {
-    if (str->length >= total_length) {
-        return create_string(str->data); // No padding needed
-    }
-
-    String result;
-    result.length = total_length;
-    result.data = (char *)malloc(total_length + 1);
-    if (result.data) {
-        strcpy(result.data, str->data); // Copy original string
-        memset(result.data + str->length, pad_char, total_length - str->length); // Fill with padding characters
-        result.data[total_length] = '\0';
-    }
-    return result;
+    return pad_right_in(NULL, str, total_length, pad_char);
 }
 
 
 // Function to convert a string to uppercase
 String to_uppercase(const String *str) {
-    String result;
-    result.length = str->length;
-    result.data = (char *)malloc(result.length + 1);
-    if (result.data) {
-        for (size_t i = 0; i < str->length; i++) {
-            result.data[i] = toupper(str->data[i]);
-        }
-        result.data[str->length] = '\0';
-    }
-    return result;
+    return to_upper_case(str);
 }
 
 // Function to convert a string to lowercase
 String to_lowercase(const String *str) {
-    String result;
-    result.length = str->length;
-    result.data = (char *)malloc(result.length + 1);
-    if (result.data) {
-        for (size_t i = 0; i < str->length; i++) {
-            result.data[i] = tolower(str->data[i]);
-        }
-        result.data[str->length] = '\0';
-    }
-    return result;
+    return to_lower_case(str);
 }
 // Function to join an array of strings with a delimiter
 String join_strings(const String *str_array, size_t array_size, const char *delimiter) {
     if (array_size == 0) return create_string(""); // Empty array
     
-    size_t delimiter_length = strlen(delimiter);
-    size_t total_length = 0;
+    StringView separator = cstr_view(delimiter);
+    size_t total_length = separator.len * (array_size - 1);
     
     // Calculate the total length needed for the resulting string
     for (size_t i = 0; i < array_size; i++) {
         total_length += str_array[i].length;
-        if (i < array_size - 1) {
-            total_length += delimiter_length;
-        }
     }
     
-    String result;
-    result.length = total_length;
-    result.data = (char *)malloc(result.length + 1);
-    
-    if (result.data) {
-        result.data[0] = '\0'; // Start with an empty string
-        for (size_t i = 0; i < array_size; i++) {
-            strcat(result.data, str_array[i].data); // Append the next string
-            if (i < array_size - 1) {
-                strcat(result.data, delimiter); // Append delimiter if it's not the last string
-            }
+    STRING_TRACK_START(started);
+    StringBuilder builder = create_string_builder(total_length);
+    for (size_t i = 0; i < array_size; i++) {
+        if (i > 0) {
+            builder_append_view(&builder, separator); // Append delimiter before every string but the first
         }
+        builder_append_string(&builder, &str_array[i]);
     }
+    String result = builder_finish(&builder);
+    STRING_TRACK_STOP(started, STRING_OP_JOIN, total_length);
     return result;
 }
 
-// Function to split a string by a delimiter into an array of strings
-String* split_string(const String *str, const char *delimiter, size_t *count) {
-    size_t tokens_count = 0;
-    char *copy = strdup(str->data); // Make a copy of the original string to tokenize
-    char *token = strtok(copy, delimiter);
-    
-    String *tokens = NULL;
-    while (token) {
-        tokens = (String *)realloc(tokens, sizeof(String) * (tokens_count + 1));
-        tokens[tokens_count] = create_string(token);
-        tokens_count++;
-        token = strtok(NULL, delimiter);
+// Function to collect every token of one string into an array of Strings, NULL when there are none
+static String* collect_tokens(const String *str, StringView delimiter, int flags, size_t *count) {
+    STRING_TRACK_START(started);
+    StreamTokenizer tokenizer = create_stream_tokenizer(delimiter, flags);
+    tokenizer_feed(&tokenizer, string_view(str));
+    tokenizer_finish(&tokenizer);
+
+    size_t size = 0, capacity = 4;
+    String *tokens = (String *)tracked_realloc(NULL, 0, capacity * sizeof(String));
+    StringView token;
+    while (tokenizer_next(&tokenizer, &token)) {
+        if (size == capacity) {
+            tokens = (String *)tracked_realloc(tokens, capacity * sizeof(String), 2 * capacity * sizeof(String));
+            capacity *= 2; // Double the capacity
+        }
+        tokens[size++] = view_to_string(token);
+    }
+    free_stream_tokenizer(&tokenizer);
+
+    // Trim the array to the tokens so free_string_array releases what was counted
+    if (size == 0) {
+        tracked_free(tokens, capacity * sizeof(String));
+        tokens = NULL;
+    } else if (size < capacity) {
+        tokens = (String *)tracked_realloc(tokens, capacity * sizeof(String), size * sizeof(String));
+    }
+
+    *count = size;
+    STRING_TRACK_STOP(started, STRING_OP_TOKENIZE, str->length);
+    return tokens;
+}
+
+// Function to split a string at any of the delimiter characters, skipping empty tokens like strtok
+String* split_string_any(const String *str, const char *delimiters, size_t *count) {
+    return collect_tokens(str, cstr_view(delimiters), TOKENIZER_DELIMITER_SET | TOKENIZER_SKIP_EMPTY, count);
+}
+
+// Function to tokenize a string by a delimiter, skipping empty tokens
+String* tokenize_string(const String *str, char delimiter, size_t *count) {
+    StringView separator = {&delimiter, 1};
+    return collect_tokens(str, separator, TOKENIZER_SKIP_EMPTY, count);
+}
+
+
+// String arena
+
+// Function to create an empty StringArena whose chunks hold chunk_size bytes
+StringArena create_string_arena(size_t chunk_size) {
+    StringArena arena;
+    arena.first = NULL;
+    arena.current = NULL;
+    arena.chunk_size = chunk_size ? chunk_size : 64 * 1024; // Default to 64 KiB chunks
+    return arena;
+}
+
+// Function to bump-allocate bytes from an arena, adding a chunk when the current one is full
+void *arena_alloc(StringArena *arena, size_t bytes) {
+    const size_t align = sizeof(void *);
+    bytes = (bytes + align - 1) & ~(align - 1); // Keep every allocation pointer-aligned
+
+    ArenaChunk *chunk = arena->current;
+    while (chunk && chunk->used + bytes > chunk->capacity) {
+        chunk = chunk->next; // Chunks kept by arena_reset are reused before new ones are added
+    }
+    if (!chunk) {
+        size_t capacity = bytes > arena->chunk_size ? bytes : arena->chunk_size;
+        chunk = (ArenaChunk *)malloc(sizeof(ArenaChunk) + capacity);
+        if (!chunk) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        STRING_TRACK_ALLOCATION(sizeof(ArenaChunk) + capacity);
+        chunk->used = 0;
+        chunk->capacity = capacity;
+        if (arena->current) {
+            chunk->next = arena->current->next;
+            arena->current->next = chunk;
+        } else {
+            chunk->next = NULL;
+            arena->first = chunk;
+        }
+    }
+    arena->current = chunk;
+
+    void *ptr = chunk->data + chunk->used;
+    chunk->used += bytes;
+    return ptr;
+}
+
+// Function to release every allocation of an arena at once, keeping its chunks for reuse
+void arena_reset(StringArena *arena) {
+    for (ArenaChunk *chunk = arena->first; chunk; chunk = chunk->next) {
+        chunk->used = 0;
+    }
+    arena->current = arena->first;
+}
+
+// Function to free an arena and all of its chunks
+void arena_free(StringArena *arena) {
+    ArenaChunk *chunk = arena->first;
+    while (chunk) {
+        ArenaChunk *next = chunk->next;
+        STRING_TRACK_RELEASE(sizeof(ArenaChunk) + chunk->capacity);
+        free(chunk);
+        chunk = next;
+    }
+    arena->first = NULL;
+    arena->current = NULL;
+}
+
+// Function to get memory from the arena, or from malloc when there is no arena; heap blocks are tracked
+static void *arena_or_heap_alloc(StringArena *arena, size_t bytes) {
+    if (arena) return arena_alloc(arena, bytes);
+    return tracked_realloc(NULL, 0, bytes);
+}
+
+// Function to resize a heap block and count it with the tracker; old_bytes is 0 for a new block
+static void *tracked_realloc(void *ptr, size_t old_bytes, size_t new_bytes) {
+    void *resized = realloc(ptr, new_bytes);
+    if (!resized) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    if (old_bytes) STRING_TRACK_RELEASE(old_bytes);
+    STRING_TRACK_ALLOCATION(new_bytes);
+    return resized;
+}
+
+// Function to free a heap block counted by tracked_realloc
+static void tracked_free(void *ptr, size_t bytes) {
+    if (ptr) STRING_TRACK_RELEASE(bytes);
+    free(ptr);
+}
+
+// Function to allocate an uninitialized, null-terminated String of the given length
+// Short strings are stored inline and touch neither the arena nor the heap
+static String string_alloc_in(StringArena *arena, size_t length) {
+    String str;
+    if (length <= STRING_SSO_CAPACITY) {
+        str.buf.storage = STRING_STORAGE_INLINE; // The capacity is STRING_SSO_CAPACITY, the bytes it would use hold characters
+    } else {
+        str.buf.data = (char *)arena_or_heap_alloc(arena, length + 1); // +1 for null terminator
+        str.buf.storage = arena ? STRING_STORAGE_ARENA : STRING_STORAGE_HEAP;
+        str.buf.capacity = length;
+    }
+    str.length = length;
+    string_data(&str)[length] = '\0';
+    return str;
+}
+
+// Function to wrap a malloc'd, null-terminated buffer of capacity + 1 bytes in a String that takes ownership of it
+static String string_from_heap(char *data, size_t length, size_t capacity) {
+    String str;
+    str.buf.data = data;
+    str.length = length;
+    str.buf.capacity = capacity;
+    str.buf.storage = STRING_STORAGE_HEAP;
+    return str;
+}
+
+// Function to create a new String in an arena
+String create_string_in(StringArena *arena, const char *initial_data) {
+    if (!initial_data) {
+        return string_from_heap(NULL, 0, 0);
+    }
+
+    STRING_TRACK_START(started);
+    size_t length = strlen(initial_data);
+    String str = string_alloc_in(arena, length);
+    memcpy(string_data(&str), initial_data, length);
+    STRING_TRACK_STOP(started, STRING_OP_CREATE, length);
+    return str;
+}
+
+// Function to copy a String into an arena
+// Without an arena, a copy of a shared String is another reference to the same characters
+String copy_string_in(StringArena *arena, const String *str) {
+    if (!str || !string_data(str)) return create_string_in(arena, NULL);
+
+    STRING_TRACK_START(started);
+    if (!arena && str->buf.storage == STRING_STORAGE_SHARED) {
+        atomic_fetch_add_explicit(&shared_buffer_of(str)->refs, 1, memory_order_relaxed);
+        STRING_TRACK_STOP(started, STRING_OP_COPY, 0); // No characters were copied
+        return *str;
+    }
+    String copy = string_alloc_in(arena, str->length);
+    memcpy(string_data(&copy), string_data(str), str->length);
+    STRING_TRACK_STOP(started, STRING_OP_COPY, str->length);
+    return copy;
+}
+
+// Function to copy a String
+String copy_string(const String *str) {
+    return copy_string_in(NULL, str);
+}
+
+// Function to create a substring in an arena
+String substring_in(StringArena *arena, const String *str, size_t start, size_t length) {
+    if (!str) return create_string_in(arena, "");
+
+    STRING_TRACK_START(started);
+    String result = view_to_string_in(arena, substring_view(string_view(str), start, length));
+    STRING_TRACK_STOP(started, STRING_OP_SUBSTRING, result.length);
+    return result;
+}
+
+// Function to concatenate two Strings into an arena
+String concatenate_strings_in(StringArena *arena, const String *str1, const String *str2) {
+    if (!str1 || !str2) return create_string_in(arena, ""); // Return empty string if invalid input
+
+    STRING_TRACK_START(started);
+    String result = string_alloc_in(arena, str1->length + str2->length);
+    if (str1->length) memcpy(string_data(&result), string_data(str1), str1->length);
+    if (str2->length) memcpy(string_data(&result) + str1->length, string_data(str2), str2->length);
+    STRING_TRACK_STOP(started, STRING_OP_CONCATENATE, result.length);
+    return result;
+}
+
+// Function to trim leading and trailing spaces into an arena
+String trim_string_in(StringArena *arena, const String *str) {
+    if (!str || !string_data(str)) return create_string_in(arena, "");
+
+    STRING_TRACK_START(started);
+    String result = view_to_string_in(arena, trim_view(string_view(str)));
+    STRING_TRACK_STOP(started, STRING_OP_TRIM, str->length);
+    return result;
+}
+
+// Function to reverse a string into an arena
+String reverse_string_in(StringArena *arena, const String *str) {
+    STRING_TRACK_START(started);
+    String reversed = string_alloc_in(arena, str->length);
+    const char *src = string_data(str);
+    char *dest = string_data(&reversed);
+    for (size_t i = 0; i < str->length; i++) {
+        dest[i] = src[str->length - i - 1];
+    }
+    STRING_TRACK_STOP(started, STRING_OP_REVERSE, str->length);
+    return reversed;
+}
+
+// Function to convert a string to upper case into an arena
+String to_upper_case_in(StringArena *arena, const String *str) {
+    if (!str || !string_data(str)) return create_string_in(arena, "");
+
+    STRING_TRACK_START(started);
+    ByteMap map = upper_case_byte_map();
+    String result = transform_bytes_in(arena, str, &map);
+    STRING_TRACK_STOP(started, STRING_OP_UPPER_CASE, str->length);
+    return result;
+}
+
+// Function to convert a string to lower case into an arena
+String to_lower_case_in(StringArena *arena, const String *str) {
+    if (!str || !string_data(str)) return create_string_in(arena, "");
+
+    STRING_TRACK_START(started);
+    ByteMap map = lower_case_byte_map();
+    String result = transform_bytes_in(arena, str, &map);
+    STRING_TRACK_STOP(started, STRING_OP_LOWER_CASE, str->length);
+    return result;
+}
+
+// Function to pad a string on the left into an arena
+String pad_left_in(StringArena *arena, const String *str, size_t total_length, char pad_char) {
+    if (str->length >= total_length) {
+        return copy_string_in(arena, str); // No padding needed
+    }
+
+    STRING_TRACK_START(started);
+    String result = string_alloc_in(arena, total_length);
+    size_t pad_size = total_length - str->length;
+    memset(string_data(&result), pad_char, pad_size); // Fill with padding characters
+    if (str->length) memcpy(string_data(&result) + pad_size, string_data(str), str->length); // Copy original string
+    STRING_TRACK_STOP(started, STRING_OP_PAD, total_length);
+    return result;
+}
+
+// Function to pad a string on the right into an arena
+String pad_right_in(StringArena *arena, const String *str, size_t total_length, char pad_char) {
+    if (str->length >= total_length) {
+        return copy_string_in(arena, str); // No padding needed
+    }
+
+    STRING_TRACK_START(started);
+    String result = string_alloc_in(arena, total_length);
+    if (str->length) memcpy(string_data(&result), string_data(str), str->length); // Copy original string
+    memset(string_data(&result) + str->length, pad_char, total_length - str->length); // Fill with padding characters
+    STRING_TRACK_STOP(started, STRING_OP_PAD, total_length);
+    return result;
+}
+
+// Function to split a string by a delimiter into an arena (both the array and the tokens)
+String* split_string_in(StringArena *arena, const String *str, char delimiter, size_t *count) {
+    STRING_TRACK_START(started);
+    const char *data = string_data(str);
+    size_t num_substrings = 1; // At least one substring
+    for (size_t i = 0; i < str->length; i++) {
+        if (data[i] == delimiter) num_substrings++;
+    }
+
+    String *result = (String *)arena_or_heap_alloc(arena, num_substrings * sizeof(String));
+    size_t start = 0, idx = 0;
+
+    for (size_t i = 0; i <= str->length; i++) {
+        if (i == str->length || data[i] == delimiter) {
+            StringView token = {data + start, i - start};
+            result[idx++] = view_to_string_in(arena, token);
+            start = i + 1;
+        }
+    }
+    *count = num_substrings;
+    STRING_TRACK_STOP(started, STRING_OP_SPLIT, str->length);
+    return result;
+}
+
+
+// String builder
+
+// Function to create an empty StringBuilder, allocating capacity_hint bytes up front
+StringBuilder create_string_builder(size_t capacity_hint) {
+    StringBuilder builder = {NULL, 0, 0};
+    builder_reserve(&builder, capacity_hint);
+    return builder;
+}
+
+// Function to make room for at least additional more bytes, growing the buffer geometrically
+void builder_reserve(StringBuilder *builder, size_t additional) {
+    size_t needed = builder->length + additional;
+    if (builder->data && needed <= builder->capacity) return;
+
+    size_t capacity = builder->capacity ? builder->capacity : 16;
+    while (capacity < needed) {
+        capacity *= 2; // Double the capacity
+    }
+    if (builder->data) STRING_TRACK_RELEASE(builder->capacity + 1);
+    builder->data = (char *)realloc(builder->data, capacity + 1); // +1 for null terminator
+    if (!builder->data) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    STRING_TRACK_ALLOCATION(capacity + 1);
+    builder->capacity = capacity;
+}
+
+// Function to append a view to a StringBuilder
+void builder_append_view(StringBuilder *builder, StringView view) {
+    builder_reserve(builder, view.len);
+    if (view.len) memcpy(builder->data + builder->length, view.ptr, view.len);
+    builder->length += view.len;
+}
+
+// Function to append a String to a StringBuilder
+void builder_append_string(StringBuilder *builder, const String *str) {
+    builder_append_view(builder, string_view(str));
+}
+
+// Function to append a null-terminated character array to a StringBuilder
+void builder_append_cstr(StringBuilder *builder, const char *cstr) {
+    builder_append_view(builder, cstr_view(cstr));
+}
+
+// Function to append one character to a StringBuilder
+void builder_append_char(StringBuilder *builder, char c) {
+    builder_reserve(builder, 1);
+    builder->data[builder->length++] = c;
+}
+
+// Function to append an integer in decimal to a StringBuilder
+void builder_append_int(StringBuilder *builder, long long value) {
+    char digits[24]; // Enough for any 64-bit value and its sign
+    unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    char *p = format_u64(digits + sizeof(digits), magnitude);
+    if (value < 0) *--p = '-';
+
+    StringView view = {p, (size_t)(digits + sizeof(digits) - p)};
+    builder_append_view(builder, view);
+}
+
+// Function to hand the built characters over as a String and leave the builder empty
+// Long results take over the buffer without copying; short ones are moved inline and the buffer is freed
+String builder_finish(StringBuilder *builder) {
+    String result;
+    if (builder->length <= STRING_SSO_CAPACITY) {
+        StringView view = {builder->data, builder->length};
+        result = view_to_string(view);
+        if (builder->data) STRING_TRACK_RELEASE(builder->capacity + 1);
+        free(builder->data);
+    } else {
+        builder->data[builder->length] = '\0';
+        result = string_from_heap(builder->data, builder->length, builder->capacity);
+    }
+    builder->data = NULL;
+    builder->length = 0;
+    builder->capacity = 0;
+    return result;
+}
+
+// Function to free a StringBuilder without producing a String
+void free_string_builder(StringBuilder *builder) {
+    if (builder->data) STRING_TRACK_RELEASE(builder->capacity + 1);
+    free(builder->data);
+    builder->data = NULL;
+    builder->length = 0;
+    builder->capacity = 0;
+}
+
+
+// String views
+
+// Function to view the characters of a String without copying them
+StringView string_view(const String *str) {
+    StringView view = {NULL, 0};
+    if (str && string_data(str)) {
+        view.ptr = string_data(str);
+        view.len = str->length;
+    }
+    return view;
+}
+
+// Function to view a null-terminated character array without copying it
+StringView cstr_view(const char *cstr) {
+    StringView view = {cstr, cstr ? strlen(cstr) : 0};
+    return view;
+}
+
+// Function to copy the characters of a view into a new String
+String view_to_string(StringView view) {
+    return view_to_string_in(NULL, view);
+}
+
+// Function to copy the characters of a view into a new String in an arena
+String view_to_string_in(StringArena *arena, StringView view) {
+    String str = string_alloc_in(arena, view.len);
+    if (view.len) memcpy(string_data(&str), view.ptr, view.len);
+    return str;
+}
+
+// Function to view part of a view, clamped to its bounds like substring
+StringView substring_view(StringView view, size_t start, size_t length) {
+    StringView sub = {view.ptr, 0};
+    if (start >= view.len) return sub; // Empty view if out of range
+
+    sub.ptr = view.ptr + start;
+    sub.len = (length > view.len - start) ? (view.len - start) : length;
+    return sub;
+}
+
+// Function to view a view without its leading and trailing spaces
+StringView trim_view(StringView view) {
+    size_t start = 0, end = view.len;
+    while (start < end && view.ptr[start] == ' ') start++;
+    while (end > start && view.ptr[end - 1] == ' ') end--;
+
+    StringView trimmed = {view.ptr + start, end - start};
+    return trimmed;
+}
+
+// Function to split a view by a delimiter into views of the same buffer
+// Only the returned array is allocated; free it with free() when done
+StringView* split_views(StringView view, char delimiter, size_t *count) {
+    size_t num_views = 1; // At least one view
+    for (const char *p = view.ptr; p && (p = memchr(p, delimiter, view.ptr + view.len - p)); p++) {
+        num_views++;
+    }
+
+    StringView *result = (StringView *)malloc(num_views * sizeof(StringView));
+    if (!result) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    const char *start = view.ptr, *end = view.ptr + view.len;
+    for (size_t idx = 0; idx < num_views; idx++) {
+        const char *stop = idx + 1 < num_views ? (const char *)memchr(start, delimiter, end - start) : end;
+        result[idx].ptr = start;
+        result[idx].len = stop - start;
+        start = stop + 1;
+    }
+    *count = num_views;
+    return result;
+}
+
+// Function to compare two views byte by byte, shorter views sorting first on a tie
+int compare_views(StringView view1, StringView view2) {
+    size_t common = view1.len < view2.len ? view1.len : view2.len;
+    int result = common ? memcmp(view1.ptr, view2.ptr, common) : 0;
+    if (result != 0) return result;
+    return (view1.len > view2.len) - (view1.len < view2.len);
+}
+
+// Function to check whether two views hold the same characters
+int views_equal(StringView view1, StringView view2) {
+    return view1.len == view2.len && (view1.len == 0 || memcmp(view1.ptr, view2.ptr, view1.len) == 0);
+}
+
+// Function to find the first occurrence of needle in haystack, embedded nulls included
+size_t find_view(StringView haystack, StringView needle) {
+    if (needle.len == 0) return 0;
+    if (needle.len > haystack.len) return STRING_NOT_FOUND;
+
+    return select_search_kernel(needle.len)(haystack.ptr, haystack.len, needle.ptr, needle.len);
+}
+
+
+// Substring search engine
+//
+// Every kernel expects 0 < needle_len <= haystack_len (single bytes always go to memchr, so
+// the SIMD kernels see at least 2) and returns the offset of the first match or
+// STRING_NOT_FOUND. The SIMD kernels compare a block of candidate positions at once against
+// the first and the last byte of the needle, and only run memcmp on the positions where
+// both agree, which on real text is almost never a false positive.
+
+// Function to search with memchr on the first byte and memcmp on the rest
+static size_t search_kernel_scalar(const char *haystack, size_t haystack_len, const char *needle, size_t needle_len) {
+    const char *p = haystack;
+    const char *last = haystack + haystack_len - needle_len;
+    while (p <= last && (p = (const char *)memchr(p, needle[0], last - p + 1))) {
+        if (memcmp(p + 1, needle + 1, needle_len - 1) == 0) return p - haystack;
+        p++;
+    }
+    return STRING_NOT_FOUND;
+}
+
+#ifdef STRING_HAVE_X86_SIMD
+// Function to search 16 candidate positions per step with SSE2
+__attribute__((target("sse2")))
+static size_t search_kernel_sse2(const char *haystack, size_t haystack_len, const char *needle, size_t needle_len) {
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needle_len - 1]);
+    size_t i = 0;
+
+    for (; i + needle_len - 1 + 16 <= haystack_len; i += 16) {
+        __m128i block_first = _mm_loadu_si128((const __m128i *)(haystack + i));
+        __m128i block_last = _mm_loadu_si128((const __m128i *)(haystack + i + needle_len - 1));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first),
+                                                                  _mm_cmpeq_epi8(last, block_last)));
+        while (mask) {
+            unsigned bit = (unsigned)__builtin_ctz(mask);
+            if (memcmp(haystack + i + bit + 1, needle + 1, needle_len - 2) == 0) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+
+    size_t rest = search_kernel_scalar(haystack + i, haystack_len - i, needle, needle_len);
+    return rest == STRING_NOT_FOUND ? rest : i + rest;
+}
+
+// Function to search 32 candidate positions per step with AVX2
+__attribute__((target("avx2")))
+static size_t search_kernel_avx2(const char *haystack, size_t haystack_len, const char *needle, size_t needle_len) {
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[needle_len - 1]);
+    size_t i = 0;
+
+    for (; i + needle_len - 1 + 32 <= haystack_len; i += 32) {
+        __m256i block_first = _mm256_loadu_si256((const __m256i *)(haystack + i));
+        __m256i block_last = _mm256_loadu_si256((const __m256i *)(haystack + i + needle_len - 1));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, block_first),
+                                                                        _mm256_cmpeq_epi8(last, block_last)));
+        while (mask) {
+            unsigned bit = (unsigned)__builtin_ctz(mask);
+            if (memcmp(haystack + i + bit + 1, needle + 1, needle_len - 2) == 0) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+
+    size_t rest = search_kernel_scalar(haystack + i, haystack_len - i, needle, needle_len);
+    return rest == STRING_NOT_FOUND ? rest : i + rest;
+}
+#endif
+
+// Function to search for a single byte, where memchr is already the best kernel
+static size_t search_kernel_byte(const char *haystack, size_t haystack_len, const char *needle, size_t needle_len) {
+    (void)needle_len;
+    const char *p = (const char *)memchr(haystack, needle[0], haystack_len);
+    return p ? (size_t)(p - haystack) : STRING_NOT_FOUND;
+}
+
+// Function to pick the fastest kernel the running CPU supports for a needle length
+static SearchKernel select_search_kernel(size_t needle_len) {
+    if (needle_len == 1) return search_kernel_byte;
+#ifdef STRING_HAVE_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) return search_kernel_avx2;
+    if (__builtin_cpu_supports("sse2")) return search_kernel_sse2;
+#endif
+    return search_kernel_scalar;
+}
+
+// Function to run a kernel from an offset, handling the cases the kernels do not accept
+static size_t run_search_kernel(SearchKernel kernel, StringView haystack, StringView needle, size_t from) {
+    if (from > haystack.len) return STRING_NOT_FOUND;
+    if (needle.len == 0) return from;
+    if (needle.len > haystack.len - from) return STRING_NOT_FOUND;
+
+    size_t pos = kernel(haystack.ptr + from, haystack.len - from, needle.ptr, needle.len);
+    return pos == STRING_NOT_FOUND ? pos : from + pos;
+}
+
+// Function to collect every match offset, overlapping ones included, into a malloc'd array
+// An empty needle has no matches here; the array is NULL when count is 0
+static size_t* collect_search_matches(SearchKernel kernel, StringView haystack, StringView needle, size_t *count) {
+    size_t size = 0, capacity = 0;
+    size_t *matches = NULL;
+
+    size_t pos = needle.len ? run_search_kernel(kernel, haystack, needle, 0) : STRING_NOT_FOUND;
+    while (pos != STRING_NOT_FOUND) {
+        if (size == capacity) {
+            size_t grown = capacity ? capacity * 2 : 16; // Double the capacity
+            matches = (size_t *)tracked_realloc(matches, capacity * sizeof(size_t), grown * sizeof(size_t));
+            capacity = grown;
+        }
+        matches[size++] = pos;
+        pos = run_search_kernel(kernel, haystack, needle, pos + 1);
+    }
+    if (size < capacity) { // Trim the array to the matches so free_match_offsets releases what was counted
+        matches = (size_t *)tracked_realloc(matches, capacity * sizeof(size_t), size * sizeof(size_t));
+    }
+    *count = size;
+    return matches;
+}
+
+// Function to find the first occurrence of needle at or after from, or STRING_NOT_FOUND
+size_t find_substring_from(const String *str, StringView needle, size_t from) {
+    if (!str) return STRING_NOT_FOUND;
+    return run_search_kernel(select_search_kernel(needle.len), string_view(str), needle, from);
+}
+
+// Function to find every occurrence of needle, returned as a malloc'd array of offsets
+size_t* find_all_substrings(const String *str, StringView needle, size_t *count) {
+    if (!str) {
+        *count = 0;
+        return NULL;
+    }
+    STRING_TRACK_START(started);
+    size_t *matches = collect_search_matches(select_search_kernel(needle.len), string_view(str), needle, count);
+    STRING_TRACK_STOP(started, STRING_OP_FIND_ALL, str->length);
+    return matches;
+}
+
+// Function to free an array returned by find_all_substrings, searcher_find_all or parallel_find_all
+void free_match_offsets(size_t *matches, size_t count) {
+    tracked_free(matches, count * sizeof(size_t));
+}
+
+// Function to prepare a needle once for searching many haystacks
+StringSearcher create_searcher(StringView needle) {
+    StringSearcher searcher;
+    searcher.needle = (char *)malloc(needle.len + 1);
+    if (!searcher.needle) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    if (needle.len) memcpy(searcher.needle, needle.ptr, needle.len);
+    searcher.needle[needle.len] = '\0';
+    searcher.length = needle.len;
+    searcher.kernel = select_search_kernel(needle.len);
+    return searcher;
+}
+
+// Function to find the first occurrence of a prepared needle at or after from
+size_t searcher_find(const StringSearcher *searcher, StringView haystack, size_t from) {
+    StringView needle = {searcher->needle, searcher->length};
+    return run_search_kernel(searcher->kernel, haystack, needle, from);
+}
+
+// Function to find every occurrence of a prepared needle, returned as a malloc'd array of offsets
+size_t* searcher_find_all(const StringSearcher *searcher, StringView haystack, size_t *count) {
+    STRING_TRACK_START(started);
+    StringView needle = {searcher->needle, searcher->length};
+    size_t *matches = collect_search_matches(searcher->kernel, haystack, needle, count);
+    STRING_TRACK_STOP(started, STRING_OP_FIND_ALL, haystack.len);
+    return matches;
+}
+
+// Function to free a prepared needle
+void free_searcher(StringSearcher *searcher) {
+    free(searcher->needle);
+    searcher->needle = NULL;
+    searcher->length = 0;
+}
+
+
+// Multi-pattern replacement
+//
+// The targets are compiled into an Aho-Corasick automaton whose failure links are folded into
+// a full 256-entry transition table, so the input is scanned once with one table lookup per
+// byte. Matching is leftmost-longest, so a short target never cuts into a longer one that
+// started earlier: the best match found so far is held back while the state's depth says a
+// match in progress began at or before it, and is replaced by any match that starts earlier or
+// starts there and ends later. Once no such match can still come, it is taken and the
+// automaton restarts right after it, so replacements never overlap.
+
+// Function to compile replacement rules; when two rules share a target the first one wins
+Replacer create_replacer(const ReplacePair *pairs, size_t count) {
+    Replacer replacer;
+    size_t max_states = 1, storage_len = 0;
+    for (size_t i = 0; i < count; i++) {
+        max_states += pairs[i].target.len;
+        storage_len += pairs[i].replacement.len;
+    }
+
+    replacer.next = (int32_t *)malloc(max_states * 256 * sizeof(int32_t));
+    replacer.output = (int32_t *)malloc(max_states * sizeof(int32_t));
+    replacer.depth = (int32_t *)malloc(max_states * sizeof(int32_t));
+    replacer.target_lengths = (size_t *)malloc((count ? count : 1) * sizeof(size_t));
+    replacer.replacements = (StringView *)malloc((count ? count : 1) * sizeof(StringView));
+    replacer.storage = (char *)malloc(storage_len + 1);
+    int32_t *fail = (int32_t *)malloc(max_states * sizeof(int32_t));
+    int32_t *queue = (int32_t *)malloc(max_states * sizeof(int32_t));
+    if (!replacer.next || !replacer.output || !replacer.depth || !replacer.target_lengths ||
+        !replacer.replacements || !replacer.storage || !fail || !queue) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    replacer.count = count;
+
+    // Build the trie of targets, -1 marking a missing edge
+    size_t states = 1;
+    memset(replacer.next, -1, 256 * sizeof(int32_t));
+    replacer.output[0] = -1;
+    replacer.depth[0] = 0;
+    for (size_t i = 0, offset = 0; i < count; i++) {
+        replacer.target_lengths[i] = pairs[i].target.len;
+        replacer.replacements[i].ptr = replacer.storage + offset;
+        replacer.replacements[i].len = pairs[i].replacement.len;
+        if (pairs[i].replacement.len) memcpy(replacer.storage + offset, pairs[i].replacement.ptr, pairs[i].replacement.len);
+        offset += pairs[i].replacement.len;
+
+        if (pairs[i].target.len == 0) continue; // An empty target never matches
+        int32_t state = 0;
+        for (size_t j = 0; j < pairs[i].target.len; j++) {
+            unsigned char byte = (unsigned char)pairs[i].target.ptr[j];
+            if (replacer.next[state * 256 + byte] < 0) {
+                memset(replacer.next + states * 256, -1, 256 * sizeof(int32_t));
+                replacer.output[states] = -1;
+                replacer.depth[states] = replacer.depth[state] + 1;
+                replacer.next[state * 256 + byte] = (int32_t)states++;
+            }
+            state = replacer.next[state * 256 + byte];
+        }
+        if (replacer.output[state] < 0) replacer.output[state] = (int32_t)i;
+    }
+
+    // Breadth-first, resolve failure links into transitions and inherit the longest suffix match
+    size_t head = 0, tail = 0;
+    for (int byte = 0; byte < 256; byte++) {
+        int32_t child = replacer.next[byte];
+        if (child < 0) {
+            replacer.next[byte] = 0;
+        } else {
+            fail[child] = 0;
+            queue[tail++] = child;
+        }
+    }
+    while (head < tail) {
+        int32_t state = queue[head++];
+        if (replacer.output[state] < 0) replacer.output[state] = replacer.output[fail[state]];
+        for (int byte = 0; byte < 256; byte++) {
+            int32_t child = replacer.next[state * 256 + byte];
+            int32_t fallback = replacer.next[fail[state] * 256 + byte];
+            if (child < 0) {
+                replacer.next[state * 256 + byte] = fallback;
+            } else {
+                fail[child] = fallback;
+                queue[tail++] = child;
+            }
+        }
+    }
+    free(fail);
+    free(queue);
+
+    replacer.next = (int32_t *)realloc(replacer.next, states * 256 * sizeof(int32_t)); // Shrink to the states used
+    return replacer;
+}
+
+// Function to apply compiled replacement rules in one pass over the input
+String replacer_apply(const Replacer *replacer, const String *str) {
+    STRING_TRACK_START(started);
+    StringView source = string_view(str);
+    size_t size = 0, capacity = 0, length = source.len;
+    size_t *matches = NULL; // Pairs of (start offset, rule index)
+
+    int32_t state = 0;
+    int32_t pending = -1;     // Rule of the best match not yet taken, or -1
+    size_t pending_start = 0; // Where that match starts
+    size_t i = 0;             // Bytes consumed
+    while (i < source.len || pending >= 0) {
+        if (i < source.len) {
+            state = replacer->next[state * 256 + (unsigned char)source.ptr[i++]];
+            int32_t rule = replacer->output[state];
+            if (rule >= 0) {
+                size_t start = i - replacer->target_lengths[rule]; // The longest target here starts leftmost
+                if (pending < 0 || start < pending_start ||
+                    (start == pending_start && replacer->target_lengths[rule] > replacer->target_lengths[pending])) {
+                    pending = rule;
+                    pending_start = start;
+                }
+            }
+            if (pending < 0 || i - (size_t)replacer->depth[state] <= pending_start) continue;
+        }
+
+        // No longer match can begin at or before pending_start: take the pending one
+        if (size == capacity) {
+            capacity = capacity ? capacity * 2 : 32; // Double the capacity
+            matches = (size_t *)realloc(matches, capacity * sizeof(size_t));
+            if (!matches) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        matches[size++] = pending_start;
+        matches[size++] = (size_t)pending;
+        length = length - replacer->target_lengths[pending] + replacer->replacements[pending].len;
+        i = pending_start + replacer->target_lengths[pending]; // Rescan from its end so matches never overlap
+        state = 0;
+        pending = -1;
+    }
+    if (size == 0) {
+        String copy = copy_string(str);
+        STRING_TRACK_STOP(started, STRING_OP_REPLACE_MANY, source.len);
+        return copy;
+    }
+
+    String result = string_alloc_in(NULL, length);
+    char *dest = string_data(&result);
+    size_t src = 0;
+    for (size_t m = 0; m < size; m += 2) {
+        size_t pos = matches[m];
+        StringView replacement = replacer->replacements[matches[m + 1]];
+        memcpy(dest, source.ptr + src, pos - src);
+        dest += pos - src;
+        if (replacement.len) memcpy(dest, replacement.ptr, replacement.len);
+        dest += replacement.len;
+        src = pos + replacer->target_lengths[matches[m + 1]];
+    }
+    memcpy(dest, source.ptr + src, source.len - src); // Copy the rest of the string
+    free(matches);
+    STRING_TRACK_STOP(started, STRING_OP_REPLACE_MANY, source.len);
+    return result;
+}
+
+// Function to free compiled replacement rules
+void free_replacer(Replacer *replacer) {
+    free(replacer->next);
+    free(replacer->output);
+    free(replacer->depth);
+    free(replacer->target_lengths);
+    free(replacer->replacements);
+    free(replacer->storage);
+    replacer->next = NULL;
+    replacer->output = NULL;
+    replacer->depth = NULL;
+    replacer->target_lengths = NULL;
+    replacer->replacements = NULL;
+    replacer->storage = NULL;
+    replacer->count = 0;
+}
+
+// Function to apply many replacement rules at once; compile a Replacer to reuse them
+String replace_many(const String *str, const ReplacePair *pairs, size_t count) {
+    Replacer replacer = create_replacer(pairs, count);
+    String result = replacer_apply(&replacer, str);
+    free_replacer(&replacer);
+    return result;
+}
+
+
+// Memory-mapped file ingest
+//
+// Lines are handed out as views straight into the mapping, so a file is never copied and no
+// line is allocated. Line ends are found 32 bytes at a time with AVX2 where available, which
+// beats calling memchr once per line when lines are short.
+
+// Function to emit one line, dropping a trailing "\r" so CRLF files give the same lines
+static void emit_line(const char *start, size_t length, LineCallback callback, void *context) {
+    if (length && start[length - 1] == '\r') length--;
+    StringView line = {start, length};
+    callback(line, context);
+}
+
+// Function to emit every complete line with memchr; returns the bytes consumed
+static size_t scan_lines_scalar(const char *data, size_t length, int final, LineCallback callback, void *context) {
+    size_t start = 0;
+    const char *newline;
+    while ((newline = (const char *)memchr(data + start, '\n', length - start))) {
+        size_t end = newline - data;
+        emit_line(data + start, end - start, callback, context);
+        start = end + 1;
+    }
+    if (final && start < length) {
+        emit_line(data + start, length - start, callback, context);
+        start = length;
+    }
+    return start;
+}
+
+#ifdef STRING_HAVE_X86_SIMD
+// Function to emit every complete line, finding the newlines of 32 bytes per step with AVX2
+__attribute__((target("avx2")))
+static size_t scan_lines_avx2(const char *data, size_t length, int final, LineCallback callback, void *context) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t start = 0, i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(data + i));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline));
+        while (mask) {
+            size_t end = i + (size_t)__builtin_ctz(mask);
+            emit_line(data + start, end - start, callback, context);
+            start = end + 1;
+            mask &= mask - 1;
+        }
+    }
+    return start + scan_lines_scalar(data + start, length - start, final, callback, context);
+}
+#endif
+
+// Function to emit every complete line with the fastest scanner the CPU supports
+// With final set, trailing bytes without a newline count as a last line; returns the bytes consumed
+static size_t scan_lines(const char *data, size_t length, int final, LineCallback callback, void *context) {
+#ifdef STRING_HAVE_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) return scan_lines_avx2(data, length, final, callback, context);
+#endif
+    return scan_lines_scalar(data, length, final, callback, context);
+}
+
+// Define a struct to represent the state of load_lines_mmap while it collects lines
+typedef struct {
+    MappedLines *lines;
+    size_t capacity;
+} LineCollector;
+
+// Function to append a line to the MappedLines being loaded
+static void collect_mapped_line(StringView line, void *context) {
+    LineCollector *collector = (LineCollector *)context;
+    MappedLines *lines = collector->lines;
+    if (lines->count == collector->capacity) {
+        collector->capacity = collector->capacity ? collector->capacity * 2 : 1024; // Double the capacity
+        lines->lines = (StringView *)realloc(lines->lines, collector->capacity * sizeof(StringView));
+        if (!lines->lines) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    lines->lines[lines->count++] = line;
+}
+
+// Function to map a whole file and split it into line views that refer to the mapping
+// Returns 0 on success, an empty file included, and -1 if the file cannot be opened or mapped;
+// lines is left empty on failure and must be released with free_mapped_lines either way
+int load_lines_mmap(const char *path, MappedLines *lines) {
+    lines->map = NULL;
+    lines->map_length = 0;
+    lines->lines = NULL;
+    lines->count = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping stays valid without the descriptor
+    if (map == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+    posix_madvise(map, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    lines->map = (char *)map;
+    lines->map_length = (size_t)st.st_size;
+    STRING_TRACK_START(started);
+    LineCollector collector = {lines, 0};
+    scan_lines(lines->map, lines->map_length, 1, collect_mapped_line, &collector);
+    STRING_TRACK_STOP(started, STRING_OP_LOAD_LINES, lines->map_length);
+    return 0;
+}
+
+// Function to unmap a file loaded with load_lines_mmap; its line views become invalid
+void free_mapped_lines(MappedLines *lines) {
+    if (lines->map) munmap(lines->map, lines->map_length);
+    free(lines->lines);
+    lines->map = NULL;
+    lines->map_length = 0;
+    lines->lines = NULL;
+    lines->count = 0;
+}
+
+// Function to stream the lines of a file of any size through a sliding window of mappings
+// Each view is valid only during its callback; returns 0 on success and -1 if the file cannot be read
+int stream_lines_mmap(const char *path, size_t window_size, LineCallback callback, void *context) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t file_size = (size_t)st.st_size;
+    size_t window = window_size < page ? page : (window_size + page - 1) / page * page;
+    size_t consumed = 0;
+
+    while (consumed < file_size) {
+        // Windows start on the page holding the first unconsumed byte, so a line cut off by the
+        // end of one window is scanned again from its start by the next
+        size_t map_start = consumed / page * page;
+        size_t map_length = file_size - map_start < window ? file_size - map_start : window;
+        int final = map_start + map_length == file_size;
+        char *map = (char *)mmap(NULL, map_length, PROT_READ, MAP_PRIVATE, fd, (off_t)map_start);
+        if (map == MAP_FAILED) {
+            perror(path);
+            close(fd);
+            return -1;
+        }
+        posix_madvise(map, map_length, POSIX_MADV_SEQUENTIAL);
+
+        size_t skip = consumed - map_start;
+        size_t used = scan_lines(map + skip, map_length - skip, final, callback, context);
+        munmap(map, map_length);
+
+        if (used == 0 && !final) {
+            window *= 2; // A single line is longer than the window
+        }
+        consumed += used;
+    }
+    close(fd);
+    return 0;
+}
+
+// StringList snapshots
+//
+// save_string_list writes a list as one file: a fixed header, a table of count + 1 offsets
+// and a blob holding every entry followed by its '\0'. open_string_list_mmap maps the file
+// privately and checks only the header against the file size, so opening costs the same for
+// ten entries or ten million. Entries are read in place: as views, or as a StringList whose
+// Strings borrow their characters from the mapping like arena Strings do (free_string leaves
+// them alone, and writing to one only touches this process's copy of the page). An offset
+// that points outside the blob reads as an empty entry; verify_mapped_string_list checks
+// the checksum and every offset for callers that do not trust the file. The file is written
+// next to its destination and renamed over it, so readers never map a half-written list.
+
+#define STRING_LIST_SNAPSHOT_MAGIC "STRLIST"             // 8 bytes with the terminator
+#define STRING_LIST_SNAPSHOT_VERSION 1
+#define STRING_LIST_SNAPSHOT_BYTE_ORDER 0x0102030405060708ULL // Reads back differently on a machine of the other byte order
+
+// Define a struct to represent the header at the start of a snapshot file, in the writer's byte order
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;  // sizeof(StringListSnapshotHeader), where the offsets table starts
+    uint64_t byte_order;   // STRING_LIST_SNAPSHOT_BYTE_ORDER
+    uint64_t count;        // Entries in the list
+    uint64_t bytes_length; // Size of the blob, terminators included
+    uint64_t checksum;     // string_list_snapshot_mix over the offsets table and every entry
+    uint64_t reserved[2];  // Zero
+} StringListSnapshotHeader;
+
+// Function to fold the hash of one entry into a running checksum, keeping the order of entries significant
+static uint64_t string_list_snapshot_mix(uint64_t checksum, StringView entry) {
+    checksum = (checksum ^ hash_view(entry)) * 0x9E3779B97F4A7C15ULL;
+    return checksum ^ (checksum >> 29);
+}
+
+// Function to write a StringList to a snapshot file that open_string_list_mmap can map back
+// Returns 0 on success and -1 if the file cannot be written, in which case path is left untouched
+int save_string_list(const StringList *list, const char *path) {
+    uint64_t *offsets = (uint64_t *)malloc((list->size + 1) * sizeof(uint64_t));
+    char *temp_path = (char *)malloc(strlen(path) + 5);
+    if (!offsets || !temp_path) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    StringListSnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, STRING_LIST_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = STRING_LIST_SNAPSHOT_VERSION;
+    header.header_size = sizeof(header);
+    header.byte_order = STRING_LIST_SNAPSHOT_BYTE_ORDER;
+    header.count = list->size;
+
+    uint64_t offset = 0;
+    for (size_t i = 0; i < list->size; i++) {
+        offsets[i] = offset;
+        offset += list->strings[i].length + 1; // Each entry keeps its terminator
+    }
+    offsets[list->size] = offset;
+    header.bytes_length = offset;
+    StringView table = {(const char *)offsets, (list->size + 1) * sizeof(uint64_t)};
+    header.checksum = hash_view(table);
+    for (size_t i = 0; i < list->size; i++) {
+        header.checksum = string_list_snapshot_mix(header.checksum, string_view(&list->strings[i]));
+    }
+
+    strcpy(temp_path, path);
+    strcat(temp_path, ".tmp");
+    FILE *file = fopen(temp_path, "wb");
+    int failed = !file;
+    if (file) {
+        failed |= fwrite(&header, sizeof(header), 1, file) != 1;
+        failed |= fwrite(offsets, table.len, 1, file) != 1;
+        for (size_t i = 0; i < list->size && !failed; i++) {
+            failed |= fwrite(string_data(&list->strings[i]), list->strings[i].length + 1, 1, file) != 1;
+        }
+        failed |= fclose(file) != 0;
+    }
+    if (!failed) failed = rename(temp_path, path) != 0;
+    if (failed) {
+        perror(path);
+        remove(temp_path);
+    }
+    free(temp_path);
+    free(offsets);
+    return failed ? -1 : 0;
+}
+
+// Function to map a snapshot file written by save_string_list without reading its entries
+// On failure the result has a NULL map and no entries
+MappedStringList open_string_list_mmap(const char *path) {
+    MappedStringList list = {NULL, 0, NULL, NULL, 0, 0};
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return list;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(StringListSnapshotHeader)) {
+        fprintf(stderr, "%s: not a string list snapshot\n", path);
+        close(fd);
+        return list;
+    }
+
+    // Writable but private, so borrowed Strings can be transformed in place without touching the file
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping stays valid without the descriptor
+    if (map == MAP_FAILED) {
+        perror(path);
+        return list;
+    }
+
+    const StringListSnapshotHeader *header = (const StringListSnapshotHeader *)map;
+    size_t length = (size_t)st.st_size;
+    size_t table_space = (length - sizeof(*header)) / sizeof(uint64_t);
+    if (memcmp(header->magic, STRING_LIST_SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != STRING_LIST_SNAPSHOT_VERSION || header->header_size != sizeof(*header) ||
+        header->byte_order != STRING_LIST_SNAPSHOT_BYTE_ORDER || header->count >= table_space ||
+        header->bytes_length != length - sizeof(*header) - (header->count + 1) * sizeof(uint64_t)) {
+        fprintf(stderr, "%s: not a string list snapshot of this version and byte order\n", path);
+        munmap(map, length);
+        return list;
+    }
+    const uint64_t *offsets = (const uint64_t *)((const char *)map + sizeof(*header));
+    if (offsets[header->count] != header->bytes_length) { // The offsets must end where the bytes do
+        fprintf(stderr, "%s: damaged string list snapshot\n", path);
+        munmap(map, length);
+        return list;
+    }
+
+    list.map = (char *)map;
+    list.map_length = length;
+    list.offsets = offsets;
+    list.bytes = list.map + sizeof(*header) + (header->count + 1) * sizeof(uint64_t);
+    list.bytes_length = (size_t)header->bytes_length;
+    list.size = (size_t)header->count;
+    return list;
+}
+
+// Function to get entry index of a mapped list as a view into the mapping, or an empty view if
+// index is out of range or the file's offsets for it are damaged
+StringView mapped_string_list_get(const MappedStringList *list, size_t index) {
+    StringView entry = {"", 0};
+    if (index >= list->size) return entry;
+
+    uint64_t start = list->offsets[index];
+    uint64_t end = list->offsets[index + 1];
+    if (start < end && end <= list->bytes_length && list->bytes[end - 1] == '\0') {
+        entry.ptr = list->bytes + start;
+        entry.len = (size_t)(end - start - 1);
+    }
+    return entry;
+}
+
+// Function to check a mapped list's checksum and offsets; returns 1 if every entry is intact
+int verify_mapped_string_list(const MappedStringList *list) {
+    if (!list->map) return 0;
+
+    const StringListSnapshotHeader *header = (const StringListSnapshotHeader *)list->map;
+    if (list->offsets[0] != 0 || list->offsets[list->size] != list->bytes_length) return 0;
+    StringView table = {(const char *)list->offsets, (list->size + 1) * sizeof(uint64_t)};
+    uint64_t checksum = hash_view(table);
+    for (size_t i = 0; i < list->size; i++) {
+        uint64_t end = list->offsets[i + 1];
+        if (end <= list->offsets[i] || end > list->bytes_length || list->bytes[end - 1] != '\0') return 0;
+        checksum = string_list_snapshot_mix(checksum, mapped_string_list_get(list, i));
+    }
+    return checksum == header->checksum;
+}
+
+// Function to get a mapped list as a StringList whose Strings borrow their characters from the mapping
+// Only the array of Strings is allocated; free it with free_string_list before unmapping the list
+StringList mapped_string_list_to_string_list(const MappedStringList *list) {
+    StringList result;
+    result.size = list->size;
+    result.capacity = list->size ? list->size : 4;
+    result.strings = (String *)tracked_realloc(NULL, 0, result.capacity * sizeof(String));
+    for (size_t i = 0; i < list->size; i++) {
+        StringView entry = mapped_string_list_get(list, i); // Null-terminated in place; damaged entries read as ""
+        String *str = &result.strings[i];
+        str->buf.data = (char *)entry.ptr;
+        str->length = entry.len;
+        str->buf.capacity = entry.len;
+        str->buf.storage = STRING_STORAGE_ARENA; // Borrowed: released with the mapping, not by free_string
+    }
+    return result;
+}
+
+// Function to unmap a list opened with open_string_list_mmap; its views and borrowed Strings become invalid
+void free_mapped_string_list(MappedStringList *list) {
+    if (list->map) munmap(list->map, list->map_length);
+    list->map = NULL;
+    list->map_length = 0;
+    list->offsets = NULL;
+    list->bytes = NULL;
+    list->bytes_length = 0;
+    list->size = 0;
+}
+
+
+// Streaming tokenizer
+//
+// Tokens are yielded as views. A token that lies inside one chunk points straight into it;
+// only a token that crosses chunk boundaries is gathered in the carry buffer, so memory stays
+// bounded by the longest token no matter how long the input is. A delimiter sequence that is
+// split across chunks is found by searching the last delimiter_length - 1 carried bytes
+// together with the start of the new chunk.
+
+// Function to create a tokenizer; flags is a combination of the TOKENIZER_* flags
+StreamTokenizer create_stream_tokenizer(StringView delimiter, int flags) {
+    StreamTokenizer tokenizer;
+    memset(&tokenizer, 0, sizeof(tokenizer));
+    tokenizer.flags = flags;
+    tokenizer.delimiter = (char *)malloc(delimiter.len + 1);
+    tokenizer.carry_capacity = 64;
+    tokenizer.carry = (char *)malloc(tokenizer.carry_capacity);
+    if (!tokenizer.delimiter || !tokenizer.carry) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    if (delimiter.len) memcpy(tokenizer.delimiter, delimiter.ptr, delimiter.len);
+    tokenizer.delimiter_length = delimiter.len;
+    for (size_t i = 0; i < delimiter.len; i++) {
+        tokenizer.is_delimiter[(unsigned char)delimiter.ptr[i]] = 1;
+    }
+    return tokenizer;
+}
+
+// Function to give the tokenizer its next chunk; the chunk must stay valid until tokenizer_next returns 0
+void tokenizer_feed(StreamTokenizer *tokenizer, StringView chunk) {
+    tokenizer->chunk = chunk.ptr;
+    tokenizer->chunk_length = chunk.len;
+    tokenizer->position = 0;
+}
+
+// Function to signal the end of the input, so the token still in progress is yielded last
+void tokenizer_finish(StreamTokenizer *tokenizer) {
+    tokenizer->finished = 1;
+}
+
+// Function to append bytes to the token being carried across chunks
+static void tokenizer_carry(StreamTokenizer *tokenizer, const char *bytes, size_t length) {
+    if (tokenizer->carry_length + length > tokenizer->carry_capacity) {
+        while (tokenizer->carry_length + length > tokenizer->carry_capacity) {
+            tokenizer->carry_capacity *= 2; // Double the capacity
+        }
+        tokenizer->carry = (char *)realloc(tokenizer->carry, tokenizer->carry_capacity);
+        if (!tokenizer->carry) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (length) memcpy(tokenizer->carry + tokenizer->carry_length, bytes, length);
+    tokenizer->carry_length += length;
+}
+
+// Function to find where the next delimiter starts in the rest of the chunk, or STRING_NOT_FOUND
+// *skip receives the number of bytes the delimiter occupies
+static size_t tokenizer_find_delimiter(const StreamTokenizer *tokenizer, size_t *skip) {
+    const char *rest = tokenizer->chunk + tokenizer->position;
+    size_t rest_length = tokenizer->chunk_length - tokenizer->position;
+
+    if (tokenizer->flags & TOKENIZER_DELIMITER_SET) {
+        *skip = 1;
+        for (size_t i = 0; i < rest_length; i++) {
+            if (tokenizer->is_delimiter[(unsigned char)rest[i]]) return i;
+        }
+        return STRING_NOT_FOUND;
+    }
+
+    StringView haystack = {rest, rest_length};
+    StringView needle = {tokenizer->delimiter, tokenizer->delimiter_length};
+    *skip = needle.len;
+    return needle.len ? find_view(haystack, needle) : STRING_NOT_FOUND;
+}
+
+// Function to check for a delimiter sequence that starts in the carry and ends in the chunk
+// Returns how many carried bytes belong to the delimiter (0 if none) and sets *consumed to its chunk part
+static size_t tokenizer_find_straddle(const StreamTokenizer *tokenizer, size_t *consumed) {
+    size_t overlap = tokenizer->delimiter_length - 1;
+    size_t tail = tokenizer->carry_length < overlap ? tokenizer->carry_length : overlap;
+    size_t rest_length = tokenizer->chunk_length - tokenizer->position;
+    size_t head = rest_length < overlap ? rest_length : overlap;
+    if (tail == 0 || head == 0 || (tokenizer->flags & TOKENIZER_DELIMITER_SET)) return 0;
+
+    char window[2 * 64];
+    char *joined = tail + head <= sizeof(window) ? window : (char *)malloc(tail + head);
+    if (!joined) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(joined, tokenizer->carry + tokenizer->carry_length - tail, tail);
+    memcpy(joined + tail, tokenizer->chunk + tokenizer->position, head);
+
+    StringView haystack = {joined, tail + head};
+    StringView needle = {tokenizer->delimiter, tokenizer->delimiter_length};
+    size_t pos = find_view(haystack, needle);
+    if (joined != window) free(joined);
+
+    if (pos == STRING_NOT_FOUND || pos >= tail) return 0; // No match, or one that lies wholly in the chunk
+    *consumed = pos + needle.len - tail;
+    return tail - pos;
+}
+
+// Function to get the next token; returns 0 when the chunk is used up (feed another) or the input is over
+// The view is valid until the next call to tokenizer_next or tokenizer_feed
+int tokenizer_next(StreamTokenizer *tokenizer, StringView *token) {
+    for (;;) {
+        if (tokenizer->done) return 0;
+        if (tokenizer->carry_returned) {
+            tokenizer->carry_length = 0;
+            tokenizer->carry_returned = 0;
+        }
+
+        size_t consumed = 0;
+        size_t carried = tokenizer->carry_length ? tokenizer_find_straddle(tokenizer, &consumed) : 0;
+        if (carried) {
+            // The delimiter began in the previous chunk: the token is the carry without it
+            tokenizer->position += consumed;
+            token->ptr = tokenizer->carry;
+            token->len = tokenizer->carry_length - carried;
+            tokenizer->carry_returned = 1;
+        } else {
+            size_t skip;
+            size_t pos = tokenizer_find_delimiter(tokenizer, &skip);
+            if (pos == STRING_NOT_FOUND) {
+                // The token goes on past this chunk: keep its start and wait for more input
+                tokenizer_carry(tokenizer, tokenizer->chunk + tokenizer->position, tokenizer->chunk_length - tokenizer->position);
+                tokenizer->position = tokenizer->chunk_length;
+                if (!tokenizer->finished) return 0;
+
+                tokenizer->done = 1;
+                token->ptr = tokenizer->carry;
+                token->len = tokenizer->carry_length;
+                tokenizer->carry_returned = 1;
+            } else if (tokenizer->carry_length) {
+                tokenizer_carry(tokenizer, tokenizer->chunk + tokenizer->position, pos);
+                tokenizer->position += pos + skip;
+                token->ptr = tokenizer->carry;
+                token->len = tokenizer->carry_length;
+                tokenizer->carry_returned = 1;
+            } else {
+                token->ptr = tokenizer->chunk + tokenizer->position; // Zero-copy: the token lies inside the chunk
+                token->len = pos;
+                tokenizer->position += pos + skip;
+            }
+        }
+
+        if (token->len > 0 || !(tokenizer->flags & TOKENIZER_SKIP_EMPTY)) return 1;
+    }
+}
+
+// Function to free a tokenizer
+void free_stream_tokenizer(StreamTokenizer *tokenizer) {
+    free(tokenizer->delimiter);
+    free(tokenizer->carry);
+    tokenizer->delimiter = NULL;
+    tokenizer->carry = NULL;
+    tokenizer->carry_length = 0;
+    tokenizer->carry_capacity = 0;
+}
+
+
+// RLE codec
+//
+// The encoded form is a sequence of records, each starting with an unsigned LEB128 varint h:
+//   h even: a literal record, the next (h >> 1) + 1 bytes are copied as they are
+//   h odd:  a run record, the next byte is repeated (h >> 1) + RLE_MIN_RUN times
+// Only runs of at least RLE_MIN_RUN bytes are encoded as runs, so digits or any other bytes
+// in the input are never ambiguous and incompressible input grows by a header per literal.
+// The encoder looks for run boundaries 32 bytes at a time with AVX2 where available.
+
+#define RLE_MIN_RUN 3
+
+#define RLE_DECODE_HEADER 0
+#define RLE_DECODE_LITERAL 1
+#define RLE_DECODE_RUN_BYTE 2
+
+// Signature of the scanners that find where runs start and end
+typedef size_t (*RleScanner)(const unsigned char *data, size_t length, size_t from);
+
+// Function to find the first position at or after from where RLE_MIN_RUN equal bytes start, or length
+static size_t rle_find_run_start_scalar(const unsigned char *data, size_t length, size_t from) {
+    for (size_t i = from; i + 2 < length; i++) {
+        if (data[i] == data[i + 1] && data[i + 1] == data[i + 2]) return i;
+    }
+    return length;
+}
+
+// Function to find the first position after from whose byte differs from data[from], or length
+static size_t rle_find_run_end_scalar(const unsigned char *data, size_t length, size_t from) {
+    size_t i = from + 1;
+    while (i < length && data[i] == data[from]) i++;
+    return i;
+}
+
+#ifdef STRING_HAVE_X86_SIMD
+// Function to find where a run starts, testing 32 positions per step with AVX2
+__attribute__((target("avx2")))
+static size_t rle_find_run_start_avx2(const unsigned char *data, size_t length, size_t from) {
+    size_t i = from;
+    for (; i + 34 <= length; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(data + i + 1));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(data + i + 2));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, b), _mm256_cmpeq_epi8(b, c)));
+        if (mask) return i + (size_t)__builtin_ctz(mask);
+    }
+    return rle_find_run_start_scalar(data, length, i);
+}
+
+// Function to find where a run ends, testing 32 bytes per step with AVX2
+__attribute__((target("avx2")))
+static size_t rle_find_run_end_avx2(const unsigned char *data, size_t length, size_t from) {
+    const __m256i byte = _mm256_set1_epi8((char)data[from]);
+    size_t i = from + 1;
+    for (; i + 32 <= length; i += 32) {
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + i)), byte));
+        if (mask) return i + (size_t)__builtin_ctz(mask);
+    }
+    while (i < length && data[i] == data[from]) i++;
+    return i;
+}
+#endif
+
+// Function to pick the run scanners the running CPU supports
+static void select_rle_scanners(RleScanner *find_start, RleScanner *find_end) {
+#ifdef STRING_HAVE_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        *find_start = rle_find_run_start_avx2;
+        *find_end = rle_find_run_end_avx2;
+        return;
+    }
+#endif
+    *find_start = rle_find_run_start_scalar;
+    *find_end = rle_find_run_end_scalar;
+}
+
+// Function to append an unsigned LEB128 varint
+static void rle_put_varint(StringBuilder *out, uint64_t value) {
+    while (value >= 0x80) {
+        builder_append_char(out, (char)(value | 0x80));
+        value >>= 7;
+    }
+    builder_append_char(out, (char)value);
+}
+
+// Function to append a literal record
+static void rle_put_literal(StringBuilder *out, const unsigned char *bytes, size_t length) {
+    if (length == 0) return;
+    rle_put_varint(out, (uint64_t)(length - 1) << 1);
+    StringView literal = {(const char *)bytes, length};
+    builder_append_view(out, literal);
+}
+
+// Function to append a run, as a run record when it is long enough and as a literal otherwise
+static void rle_put_run(StringBuilder *out, unsigned char byte, uint64_t count) {
+    if (count < RLE_MIN_RUN) {
+        unsigned char bytes[RLE_MIN_RUN] = {byte, byte, byte};
+        rle_put_literal(out, bytes, (size_t)count);
+        return;
+    }
+    rle_put_varint(out, ((count - RLE_MIN_RUN) << 1) | 1);
+    builder_append_char(out, (char)byte);
+}
+
+// Function to create a streaming RLE encoder
+RleEncoder create_rle_encoder(void) {
+    RleEncoder encoder = {0, 0};
+    return encoder;
+}
+
+// Function to encode the next chunk of input, appending the records to out
+// A run reaching the end of the chunk is held back so it can continue into the next one
+void rle_encoder_feed(RleEncoder *encoder, StringView chunk, StringBuilder *out) {
+    const unsigned char *data = (const unsigned char *)chunk.ptr;
+    size_t length = chunk.len, i = 0;
+    if (length == 0) return;
+
+    RleScanner find_start, find_end;
+    select_rle_scanners(&find_start, &find_end);
+
+    // Continue the run held back from the previous chunk
+    if (encoder->tail_count) {
+        if (data[0] == encoder->tail_byte) {
+            i = find_end(data, length, 0);
+            encoder->tail_count += i;
+            if (i == length) return;
+        }
+        rle_put_run(out, encoder->tail_byte, encoder->tail_count);
+        encoder->tail_count = 0;
+    }
+
+    // Hold back the run the chunk ends with (possibly a single byte)
+    size_t end = length - 1;
+    while (end > i && data[end - 1] == data[length - 1]) end--;
+    encoder->tail_byte = data[length - 1];
+    encoder->tail_count = length - end;
+
+    while (i < end) {
+        size_t run = find_start(data, end, i);
+        rle_put_literal(out, data + i, run - i);
+        if (run == end) break;
+        i = find_end(data, end, run);
+        rle_put_run(out, data[run], i - run);
+    }
+}
+
+// Function to flush the run still held back at the end of the input
+void rle_encoder_finish(RleEncoder *encoder, StringBuilder *out) {
+    if (encoder->tail_count) rle_put_run(out, encoder->tail_byte, encoder->tail_count);
+    encoder->tail_count = 0;
+}
+
+// Function to encode a whole input at once
+String rle_encode(StringView input) {
+    StringBuilder out = create_string_builder(input.len / 2 + 16);
+    RleEncoder encoder = create_rle_encoder();
+    rle_encoder_feed(&encoder, input, &out);
+    rle_encoder_finish(&encoder, &out);
+    return builder_finish(&out);
+}
+
+// Function to step a decoder over a chunk without writing anything, adding up its output size
+// Returns 0 on success and -1 on malformed input or a size that does not fit in size_t
+static int rle_measure(RleDecoder *decoder, StringView chunk, size_t *needed) {
+    const unsigned char *data = (const unsigned char *)chunk.ptr;
+    for (size_t i = 0; i < chunk.len;) {
+        if (decoder->state == RLE_DECODE_HEADER) {
+            if (decoder->shift > 63 || (decoder->shift == 63 && (data[i] & 0x7E))) return -1; // Past 64 bits
+            decoder->value |= (uint64_t)(data[i] & 0x7F) << decoder->shift;
+            decoder->shift += 7;
+            if (data[i++] & 0x80) continue;
+
+            uint64_t header = decoder->value;
+            decoder->state = (header & 1) ? RLE_DECODE_RUN_BYTE : RLE_DECODE_LITERAL;
+            decoder->value = (header >> 1) + ((header & 1) ? RLE_MIN_RUN : 1);
+            decoder->shift = 0;
+            if (decoder->value < (header >> 1) || decoder->value > SIZE_MAX - *needed) return -1; // Overflow
+        } else if (decoder->state == RLE_DECODE_LITERAL) {
+            size_t take = chunk.len - i < decoder->value ? chunk.len - i : (size_t)decoder->value;
+            *needed += take;
+            i += take;
+            decoder->value -= take;
+            if (decoder->value == 0) decoder->state = RLE_DECODE_HEADER;
+        } else {
+            *needed += (size_t)decoder->value;
+            i++;
+            decoder->value = 0;
+            decoder->state = RLE_DECODE_HEADER;
+        }
+    }
+    return 0;
+}
+
+// Function to decode a chunk straight into out, which must have room for all of it
+// The chunk must already have passed rle_measure; returns the number of bytes written
+static size_t rle_decode_into(RleDecoder *decoder, StringView chunk, char *out) {
+    const unsigned char *data = (const unsigned char *)chunk.ptr;
+    size_t written = 0;
+    for (size_t i = 0; i < chunk.len;) {
+        if (decoder->state == RLE_DECODE_HEADER) {
+            decoder->value |= (uint64_t)(data[i] & 0x7F) << decoder->shift;
+            decoder->shift += 7;
+            if (data[i++] & 0x80) continue;
+
+            uint64_t header = decoder->value;
+            decoder->state = (header & 1) ? RLE_DECODE_RUN_BYTE : RLE_DECODE_LITERAL;
+            decoder->value = (header >> 1) + ((header & 1) ? RLE_MIN_RUN : 1);
+            decoder->shift = 0;
+        } else if (decoder->state == RLE_DECODE_LITERAL) {
+            size_t take = chunk.len - i < decoder->value ? chunk.len - i : (size_t)decoder->value;
+            memcpy(out + written, data + i, take);
+            written += take;
+            i += take;
+            decoder->value -= take;
+            if (decoder->value == 0) decoder->state = RLE_DECODE_HEADER;
+        } else {
+            memset(out + written, data[i++], (size_t)decoder->value);
+            written += (size_t)decoder->value;
+            decoder->value = 0;
+            decoder->state = RLE_DECODE_HEADER;
+        }
+    }
+    return written;
+}
+
+// Function to compute the exact decoded size of an encoded input without decoding it
+// Returns STRING_NOT_FOUND if the input is truncated or malformed
+size_t rle_decoded_length(StringView encoded) {
+    RleDecoder decoder = create_rle_decoder();
+    size_t total = 0;
+    if (rle_measure(&decoder, encoded, &total) != 0 || rle_decoder_finish(&decoder) != 0) return STRING_NOT_FOUND;
+    return total;
+}
+
+// Function to create a streaming RLE decoder
+RleDecoder create_rle_decoder(void) {
+    RleDecoder decoder = {RLE_DECODE_HEADER, 0, 0};
+    return decoder;
+}
+
+// Function to decode the next chunk of encoded input, appending the output to out
+// Records may be split anywhere between chunks; returns 0 on success and -1 on malformed input,
+// including output that would take out past RLE_MAX_DECODED bytes
+int rle_decoder_feed(RleDecoder *decoder, StringView chunk, StringBuilder *out) {
+    // Size this chunk's output first, so out grows once and decoding writes straight into it
+    RleDecoder sizing = *decoder;
+    size_t needed = 0;
+    if (rle_measure(&sizing, chunk, &needed) != 0 || out->length > RLE_MAX_DECODED ||
+        needed > RLE_MAX_DECODED - out->length) {
+        return -1;
+    }
+
+    builder_reserve(out, needed);
+    out->length += rle_decode_into(decoder, chunk, out->data + out->length);
+    return 0;
+}
+
+// Function to check that the encoded input did not stop in the middle of a record
+int rle_decoder_finish(const RleDecoder *decoder) {
+    return decoder->state == RLE_DECODE_HEADER && decoder->shift == 0 ? 0 : -1;
+}
+
+
+// Byte transforms
+//
+// Every character-by-character transform is a 256-entry byte map. compile_byte_map looks for
+// runs of bytes that the map shifts by the same amount; when there are few of them the map is
+// applied 32 (AVX2) or 16 (SSE2) bytes at a time by testing each range with one unsigned
+// compare and adding its shift under the resulting mask. Any other map, the identity included,
+// is applied through its 256-entry table with pshufb: the table is 16 rows of 16 bytes, each row
+// is looked up by the low nibble of every input byte, and a saturating add keeps each lookup
+// only for the bytes whose high nibble selects that row. The maps are plain ASCII and do not
+// depend on the C locale the way toupper and tolower do.
+
+// Function to add a shifted range to a map under construction
+static void byte_map_add_range(ByteMap *map, unsigned char low, unsigned char high, int delta) {
+    map->low[map->range_count] = low;
+    map->high[map->range_count] = high;
+    map->delta[map->range_count] = (unsigned char)delta;
+    map->range_count++;
+}
+
+// Function to compile a byte table, where every byte b becomes table[b], into a ByteMap
+ByteMap compile_byte_map(const unsigned char table[256]) {
+    ByteMap map;
+    map.range_count = 0;
+    for (int b = 0; b < 256;) {
+        unsigned char delta = (unsigned char)(table[b] - b);
+        int end = b + 1;
+        while (end < 256 && (unsigned char)(table[end] - end) == delta) end++;
+        if (delta != 0) {
+            if (map.range_count == BYTE_MAP_MAX_RANGES) {
+                map.range_count = 0; // Too many ranges to be worth comparing against, use the table
+                memcpy(map.table, table, 256);
+                return map;
+            }
+            byte_map_add_range(&map, (unsigned char)b, (unsigned char)(end - 1), delta);
+        }
+        b = end;
+    }
+    if (map.range_count == 0) {
+        memcpy(map.table, table, 256); // The identity, which the table applies just as well
+    }
+    return map;
+}
+
+// Function to get the map that turns ASCII lowercase letters into uppercase
+ByteMap upper_case_byte_map(void) {
+    ByteMap map;
+    map.range_count = 0;
+    byte_map_add_range(&map, 'a', 'z', 'A' - 'a');
+    return map;
+}
+
+// Function to get the map that turns ASCII uppercase letters into lowercase
+ByteMap lower_case_byte_map(void) {
+    ByteMap map;
+    map.range_count = 0;
+    byte_map_add_range(&map, 'A', 'Z', 'a' - 'A');
+    return map;
+}
+
+// Function to get the map that rotates ASCII letters by shift places, keeping their case
+ByteMap caesar_byte_map(int shift) {
+    ByteMap map;
+    map.range_count = 0;
+    shift %= 26;
+    if (shift < 0) shift += 26;
+    if (shift == 0) {
+        for (int b = 0; b < 256; b++) map.table[b] = (unsigned char)b;
+        return map;
+    }
+    byte_map_add_range(&map, 'a', (unsigned char)('z' - shift), shift);
+    byte_map_add_range(&map, (unsigned char)('z' - shift + 1), 'z', shift - 26);
+    byte_map_add_range(&map, 'A', (unsigned char)('Z' - shift), shift);
+    byte_map_add_range(&map, (unsigned char)('Z' - shift + 1), 'Z', shift - 26);
+    return map;
+}
+
+// Function to apply a map one byte at a time
+static void apply_byte_map_scalar(const ByteMap *map, const unsigned char *src, unsigned char *dest, size_t length) {
+    if (map->range_count == 0) {
+        for (size_t i = 0; i < length; i++) {
+            dest[i] = map->table[src[i]];
+        }
+        return;
+    }
+    for (size_t i = 0; i < length; i++) {
+        unsigned char byte = src[i];
+        for (size_t r = 0; r < map->range_count; r++) {
+            if ((unsigned char)(byte - map->low[r]) <= (unsigned char)(map->high[r] - map->low[r])) {
+                byte = (unsigned char)(byte + map->delta[r]);
+                break;
+            }
+        }
+        dest[i] = byte;
+    }
+}
+
+#ifdef STRING_HAVE_X86_SIMD
+// Function to apply a range map 16 bytes per step with SSE2
+__attribute__((target("sse2")))
+static size_t apply_byte_map_sse2(const ByteMap *map, const unsigned char *src, unsigned char *dest, size_t length) {
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i result = bytes;
+        for (size_t r = 0; r < map->range_count; r++) {
+            // byte - low <= high - low as unsigned bytes, which min_epu8 turns into an equality
+            __m128i offset = _mm_sub_epi8(bytes, _mm_set1_epi8((char)map->low[r]));
+            __m128i inside = _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8((char)(map->high[r] - map->low[r]))), offset);
+            result = _mm_add_epi8(result, _mm_and_si128(inside, _mm_set1_epi8((char)map->delta[r])));
+        }
+        _mm_storeu_si128((__m128i *)(dest + i), result);
+    }
+    return i;
+}
+
+// Function to apply a range map 32 bytes per step with AVX2
+__attribute__((target("avx2")))
+static size_t apply_byte_map_avx2(const ByteMap *map, const unsigned char *src, unsigned char *dest, size_t length) {
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i result = bytes;
+        for (size_t r = 0; r < map->range_count; r++) {
+            __m256i offset = _mm256_sub_epi8(bytes, _mm256_set1_epi8((char)map->low[r]));
+            __m256i inside = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, _mm256_set1_epi8((char)(map->high[r] - map->low[r]))), offset);
+            result = _mm256_add_epi8(result, _mm256_and_si256(inside, _mm256_set1_epi8((char)map->delta[r])));
+        }
+        _mm256_storeu_si256((__m256i *)(dest + i), result);
+    }
+    return i;
+}
+
+// Function to apply a table map 16 bytes per step with SSSE3, one pshufb per row of the table
+__attribute__((target("ssse3")))
+static size_t apply_byte_table_ssse3(const ByteMap *map, const unsigned char *src, unsigned char *dest, size_t length) {
+    __m128i rows[16];
+    for (int h = 0; h < 16; h++) {
+        rows[h] = _mm_loadu_si128((const __m128i *)(map->table + 16 * h));
+    }
+    const __m128i bias = _mm_set1_epi8(0x70);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i result = _mm_setzero_si128();
+        for (int h = 0; h < 16; h++) {
+            // The index keeps bit 7 clear, so pshufb does not zero the lookup, only where the high nibble is h
+            __m128i index = _mm_adds_epu8(_mm_xor_si128(bytes, _mm_set1_epi8((char)(h << 4))), bias);
+            result = _mm_or_si128(result, _mm_shuffle_epi8(rows[h], index));
+        }
+        _mm_storeu_si128((__m128i *)(dest + i), result);
+    }
+    return i;
+}
+
+// Function to apply a table map 32 bytes per step with AVX2, one pshufb per row of the table
+__attribute__((target("avx2")))
+static size_t apply_byte_table_avx2(const ByteMap *map, const unsigned char *src, unsigned char *dest, size_t length) {
+    __m256i rows[16];
+    for (int h = 0; h < 16; h++) {
+        rows[h] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(map->table + 16 * h)));
+    }
+    const __m256i bias = _mm256_set1_epi8(0x70);
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i result = _mm256_setzero_si256();
+        for (int h = 0; h < 16; h++) {
+            __m256i index = _mm256_adds_epu8(_mm256_xor_si256(bytes, _mm256_set1_epi8((char)(h << 4))), bias);
+            result = _mm256_or_si256(result, _mm256_shuffle_epi8(rows[h], index));
+        }
+        _mm256_storeu_si256((__m256i *)(dest + i), result);
+    }
+    return i;
+}
+#endif
+
+// Function to apply a map to length bytes; src and dest may be the same buffer
+static void apply_byte_map(const ByteMap *map, const char *src, char *dest, size_t length) {
+    const unsigned char *in = (const unsigned char *)src;
+    unsigned char *out = (unsigned char *)dest;
+    size_t done = 0;
+#ifdef STRING_HAVE_X86_SIMD
+    if (map->range_count > 0) {
+        if (__builtin_cpu_supports("avx2")) {
+            done = apply_byte_map_avx2(map, in, out, length);
+        } else if (__builtin_cpu_supports("sse2")) {
+            done = apply_byte_map_sse2(map, in, out, length);
+        }
+    } else if (__builtin_cpu_supports("avx2")) {
+        done = apply_byte_table_avx2(map, in, out, length);
+    } else if (__builtin_cpu_supports("ssse3")) {
+        done = apply_byte_table_ssse3(map, in, out, length);
+    }
+#endif
+    apply_byte_map_scalar(map, in + done, out + done, length - done);
+}
+
+// Function to transform every byte of a string through a map into an arena
+static String transform_bytes_in(StringArena *arena, const String *str, const ByteMap *map) {
+    String result = string_alloc_in(arena, str->length);
+    apply_byte_map(map, string_data(str), string_data(&result), str->length);
+    return result;
+}
+
+// Function to transform every byte of a string through a map
+String transform_bytes(const String *str, const ByteMap *map) {
+    if (!str || !string_data(str)) return create_string("");
+
+    STRING_TRACK_START(started);
+    String result = transform_bytes_in(NULL, str, map);
+    STRING_TRACK_STOP(started, STRING_OP_TRANSFORM, str->length);
+    return result;
+}
+
+
+// In-place transforms
+//
+// These rewrite the String they are given instead of producing a new one, so a pipeline of
+// transforms costs no allocation as long as each result fits in the capacity. Inline and heap
+// strings grow geometrically when they must; an arena string that has to grow is moved to the
+// heap, since the arena cannot extend a block, and from then on must be released with free_string.
+
+// Function to make sure a String can hold capacity characters without growing again
+void string_reserve(String *str, size_t capacity) {
+    size_t current = string_capacity(str);
+    if (capacity <= current) return;
+
+    size_t new_capacity = current ? current : 16;
+    while (new_capacity < capacity) {
+        new_capacity *= 2; // Double the capacity
+    }
+    if (str->buf.storage == STRING_STORAGE_HEAP) {
+        if (str->buf.data) STRING_TRACK_RELEASE(str->buf.capacity + 1);
+        char *data = (char *)realloc(str->buf.data, new_capacity + 1); // +1 for null terminator
+        if (!data) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        if (!str->buf.data) data[0] = '\0'; // A String without data becomes an empty one
+        str->buf.data = data;
+    } else {
+        // Inline, arena and shared storage cannot grow where they are, move the characters to the heap
+        char *data = (char *)malloc(new_capacity + 1);
+        if (!data) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(data, string_data(str), str->length + 1);
+        if (str->buf.storage == STRING_STORAGE_SHARED) string_release_shared(str);
+        str->buf.data = data;
+        str->buf.storage = STRING_STORAGE_HEAP;
+    }
+    STRING_TRACK_ALLOCATION(new_capacity + 1);
+    str->buf.capacity = new_capacity;
+}
+
+// Function to trim leading and trailing spaces in place
+void trim_string_inplace(String *str) {
+    if (!string_data(str)) return;
+
+    STRING_TRACK_START(started);
+    StringView trimmed = trim_view(string_view(str));
+    if (trimmed.len != str->length) { // Otherwise nothing is written, and a shared buffer stays shared
+        size_t offset = (size_t)(trimmed.ptr - string_data(str));
+        string_make_unique(str);
+        char *data = string_data(str);
+        if (offset) memmove(data, data + offset, trimmed.len);
+        data[trimmed.len] = '\0';
+    }
+    STRING_TRACK_STOP(started, STRING_OP_TRIM, str->length);
+    str->length = trimmed.len;
+}
+
+// Function to transform every byte of a string through a map in place
+void transform_bytes_inplace(String *str, const ByteMap *map) {
+    if (!string_data(str)) return;
+
+    STRING_TRACK_START(started);
+    string_make_unique(str);
+    char *data = string_data(str);
+    apply_byte_map(map, data, data, str->length);
+    STRING_TRACK_STOP(started, STRING_OP_TRANSFORM, str->length);
+}
+
+// Function to convert a string to upper case in place
+void to_upper_case_inplace(String *str) {
+    STRING_TRACK_START(started);
+    ByteMap map = upper_case_byte_map();
+    transform_bytes_inplace(str, &map);
+    STRING_TRACK_STOP(started, STRING_OP_UPPER_CASE, str->length);
+}
+
+// Function to convert a string to lower case in place
+void to_lower_case_inplace(String *str) {
+    STRING_TRACK_START(started);
+    ByteMap map = lower_case_byte_map();
+    transform_bytes_inplace(str, &map);
+    STRING_TRACK_STOP(started, STRING_OP_LOWER_CASE, str->length);
+}
+
+// Function to reverse a string in place
+void reverse_string_inplace(String *str) {
+    if (!string_data(str) || str->length < 2) return;
+
+    STRING_TRACK_START(started);
+    string_make_unique(str);
+    char *data = string_data(str);
+    for (size_t i = 0, j = str->length - 1; i < j; i++, j--) {
+        char c = data[i];
+        data[i] = data[j];
+        data[j] = c;
+    }
+    STRING_TRACK_STOP(started, STRING_OP_REVERSE, str->length);
+}
+
+// Caesar Cipher encryption in place
+void encrypt_string_inplace(String *str, int shift) {
+    STRING_TRACK_START(started);
+    ByteMap map = caesar_byte_map(shift);
+    transform_bytes_inplace(str, &map);
+    STRING_TRACK_STOP(started, STRING_OP_ENCRYPT, str->length);
+}
+
+// Caesar Cipher decryption in place
+void decrypt_string_inplace(String *str, int shift) {
+    encrypt_string_inplace(str, 26 - (shift % 26)); // Decryption is just encryption with reverse shift
+}
+
+// Function to replace all non-overlapping occurrences of target in place, returns the number replaced
+// The result is written over the original when it is no longer; a longer result first moves the
+// original to the end of the (grown if needed) buffer and is then written from the front, which
+// never overtakes the characters still to be read
+size_t replace_substring_inplace(String *str, StringView target, StringView replacement) {
+    if (target.len == 0 || !string_data(str)) return 0;
+
+    STRING_TRACK_START(started);
+    SearchKernel kernel = select_search_kernel(target.len);
+    StringView source = string_view(str);
+    size_t matches = 0;
+    for (size_t pos = run_search_kernel(kernel, source, target, 0); pos != STRING_NOT_FOUND;
+         pos = run_search_kernel(kernel, source, target, pos + target.len)) {
+        matches++;
+    }
+    if (matches == 0) {
+        STRING_TRACK_STOP(started, STRING_OP_REPLACE, source.len);
+        return 0;
+    }
+
+    string_make_unique(str);
+    size_t new_length = source.len - matches * target.len + matches * replacement.len;
+    size_t shift = 0;
+    if (new_length > source.len) {
+        string_reserve(str, new_length);
+        shift = new_length - source.len;
+        memmove(string_data(str) + shift, string_data(str), source.len);
+    }
+
+    char *data = string_data(str);
+    source.ptr = data + shift;
+    size_t dest = 0;
+    size_t src = 0;
+    for (size_t pos = run_search_kernel(kernel, source, target, 0); pos != STRING_NOT_FOUND;
+         pos = run_search_kernel(kernel, source, target, pos + target.len)) {
+        memmove(data + dest, source.ptr + src, pos - src);
+        dest += pos - src;
+        if (replacement.len) memcpy(data + dest, replacement.ptr, replacement.len);
+        dest += replacement.len;
+        src = pos + target.len;
+    }
+    memmove(data + dest, source.ptr + src, source.len - src); // Move the rest of the string
+    str->length = new_length;
+    data[new_length] = '\0';
+    STRING_TRACK_STOP(started, STRING_OP_REPLACE, source.len);
+    return matches;
+}
+
+// Function to pad a string on the left to a specific length in place
+void pad_left_inplace(String *str, size_t total_length, char pad_char) {
+    if (str->length >= total_length) return; // No padding needed
+
+    STRING_TRACK_START(started);
+    string_make_unique(str);
+    string_reserve(str, total_length);
+    char *data = string_data(str);
+    size_t pad_size = total_length - str->length;
+    memmove(data + pad_size, data, str->length);
+    memset(data, pad_char, pad_size); // Fill with padding characters
+    str->length = total_length;
+    data[total_length] = '\0';
+    STRING_TRACK_STOP(started, STRING_OP_PAD, total_length);
+}
+
+// Function to pad a string on the right to a specific length in place
+void pad_right_inplace(String *str, size_t total_length, char pad_char) {
+    if (str->length >= total_length) return; // No padding needed
+
+    STRING_TRACK_START(started);
+    string_make_unique(str);
+    string_reserve(str, total_length);
+    char *data = string_data(str);
+    memset(data + str->length, pad_char, total_length - str->length); // Fill with padding characters
+    str->length = total_length;
+    data[total_length] = '\0';
+    STRING_TRACK_STOP(started, STRING_OP_PAD, total_length);
+}
+
+
+// Copy-on-write sharing
+//
+// share_string moves a String's characters into a SharedBuffer, a heap block that starts with
+// an atomic reference count. From then on copy_string (and so add_string_to_list) only bumps
+// the count, so putting one payload into many lists costs O(1) per insertion and the bytes
+// exist once. free_string drops a reference and the last one frees the block. The in-place
+// transforms call string_make_unique first: a String that still shares its buffer gets a
+// private copy before the write, while the only remaining owner writes where it is. The count
+// is atomic, so references may be copied, mutated and freed on different threads; the
+// characters themselves are never written while more than one String can see them.
+
+// Function to get the SharedBuffer a shared String's characters live in
+static SharedBuffer *shared_buffer_of(const String *str) {
+    return (SharedBuffer *)(str->buf.data - offsetof(SharedBuffer, data));
+}
+
+// Function to move a String's characters into a shared buffer so copies of it are O(1)
+// Inline strings are left as they are, since copying them costs no more than sharing. An
+// arena string is moved out of its arena and must be released with free_string from then on
+void share_string(String *str) {
+    if (str->buf.storage == STRING_STORAGE_INLINE || str->buf.storage == STRING_STORAGE_SHARED || !str->buf.data) return;
+
+    SharedBuffer *shared = (SharedBuffer *)malloc(sizeof(SharedBuffer) + str->length + 1);
+    if (!shared) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    STRING_TRACK_ALLOCATION(sizeof(SharedBuffer) + str->length + 1);
+    atomic_init(&shared->refs, 1);
+    memcpy(shared->data, str->buf.data, str->length + 1);
+    if (str->buf.storage == STRING_STORAGE_HEAP) {
+        STRING_TRACK_RELEASE(str->buf.capacity + 1);
+        free(str->buf.data);
+    }
+    str->buf.data = shared->data;
+    str->buf.capacity = str->length;
+    str->buf.storage = STRING_STORAGE_SHARED;
+}
+
+// Function to get how many Strings hold the characters of this one, 1 unless it is shared
+size_t string_ref_count(const String *str) {
+    if (str->buf.storage != STRING_STORAGE_SHARED) return 1;
+    return atomic_load_explicit(&shared_buffer_of(str)->refs, memory_order_acquire);
+}
+
+// Function to drop a shared String's reference, freeing the buffer with the last one
+static void string_release_shared(String *str) {
+    SharedBuffer *shared = shared_buffer_of(str);
+    if (atomic_fetch_sub_explicit(&shared->refs, 1, memory_order_release) == 1) {
+        atomic_thread_fence(memory_order_acquire); // Every other owner is done reading before the free
+        STRING_TRACK_RELEASE(sizeof(SharedBuffer) + str->buf.capacity + 1);
+        free(shared);
+    }
+}
+
+// Function to give a String characters no other String can see before it is written to
+// A shared String whose buffer has other owners gets a private copy; the last owner keeps the buffer
+static void string_make_unique(String *str) {
+    if (str->buf.storage != STRING_STORAGE_SHARED) return;
+    if (atomic_load_explicit(&shared_buffer_of(str)->refs, memory_order_acquire) == 1) return;
+
+    String copy = string_alloc_in(NULL, str->length);
+    memcpy(string_data(&copy), str->buf.data, str->length);
+    string_release_shared(str);
+    *str = copy;
+}
+
+// Thread pool
+//
+// Workers sleep on a condition variable between jobs. A job is a task function and a number
+// of tasks; the caller and the workers claim task indices from one atomic counter until none
+// are left, which balances uneven tasks the way work stealing would without per-thread queues.
+// The nthreads-taking functions share one pool that grows to the largest nthreads asked for,
+// so batch calls do not pay for creating threads; a call made while that pool is busy (from
+// another thread, or from inside one of its tasks) runs its tasks on the calling thread.
+
+// Function to claim and run tasks of a job until none are left
+static void thread_pool_drain(ThreadPool *pool, PoolTask task, void *context, size_t task_count) {
+    size_t index;
+    while ((index = atomic_fetch_add_explicit(&pool->next_task, 1, memory_order_relaxed)) < task_count) {
+        task(context, index);
+    }
+}
+
+// Function run by each pool thread: wait for a job, help with it, repeat until the pool stops
+static void *thread_pool_worker(void *arg) {
+    ThreadPool *pool = (ThreadPool *)arg;
+    size_t seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stopping && pool->generation == seen) {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+        if (pool->stopping) break;
+        seen = pool->generation;
+        if (pool->workers_wanted == 0) continue; // The job has all the workers it asked for
+
+        pool->workers_wanted--;
+        pool->workers_busy++;
+        PoolTask task = pool->task;
+        void *context = pool->context;
+        size_t task_count = pool->task_count;
+        pthread_mutex_unlock(&pool->lock);
+        thread_pool_drain(pool, task, context, task_count);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->workers_busy == 0) pthread_cond_signal(&pool->work_done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// Function to create a pool of nthreads worker threads; the thread calling thread_pool_run works too
+ThreadPool *create_thread_pool(size_t nthreads) {
+    ThreadPool *pool = (ThreadPool *)malloc(sizeof(ThreadPool));
+    pthread_t *threads = (pthread_t *)malloc((nthreads ? nthreads : 1) * sizeof(pthread_t));
+    if (!pool || !threads) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    pool->threads = threads;
+    pool->thread_count = 0;
+    pthread_mutex_init(&pool->run_lock, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+    pool->task = NULL;
+    pool->context = NULL;
+    pool->task_count = 0;
+    atomic_init(&pool->next_task, 0);
+    pool->workers_wanted = 0;
+    pool->workers_busy = 0;
+    pool->generation = 0;
+    pool->stopping = 0;
+    for (size_t t = 0; t < nthreads; t++) {
+        if (pthread_create(&pool->threads[pool->thread_count], NULL, thread_pool_worker, pool) == 0) {
+            pool->thread_count++; // Carry on with fewer threads if the system refuses more
+        }
+    }
+    return pool;
+}
+
+// Function to run tasks 0 .. task_count - 1 on the calling thread and up to helpers pool workers
+// The caller must hold run_lock; returns once every task has finished
+static void thread_pool_dispatch(ThreadPool *pool, PoolTask task, void *context, size_t task_count, size_t helpers) {
+    if (helpers > pool->thread_count) helpers = pool->thread_count;
+    if (helpers > task_count - 1) helpers = task_count - 1; // More helpers than tasks would only idle
+    if (task_count <= 1 || helpers == 0) {
+        for (size_t i = 0; i < task_count; i++) {
+            task(context, i);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->context = context;
+    pool->task_count = task_count;
+    atomic_store_explicit(&pool->next_task, 0, memory_order_relaxed);
+    pool->workers_wanted = helpers;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    thread_pool_drain(pool, task, context, task_count);
+
+    // Close the job to late joiners, then wait for the workers still running a task
+    pthread_mutex_lock(&pool->lock);
+    pool->workers_wanted = 0;
+    while (pool->workers_busy > 0) {
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Function to run tasks 0 .. task_count - 1 on the pool and the calling thread, returning when all are done
+// Jobs from several threads take turns; a task must not call thread_pool_run on its own pool
+void thread_pool_run(ThreadPool *pool, PoolTask task, void *context, size_t task_count) {
+    pthread_mutex_lock(&pool->run_lock);
+    thread_pool_dispatch(pool, task, context, task_count, pool->thread_count);
+    pthread_mutex_unlock(&pool->run_lock);
+}
+
+// Function to stop the worker threads and free a ThreadPool
+void free_thread_pool(ThreadPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t t = 0; t < pool->thread_count; t++) {
+        pthread_join(pool->threads[t], NULL);
+    }
+    pthread_cond_destroy(&pool->work_done);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->run_lock);
+    free(pool->threads);
+    free(pool);
+}
+
+static pthread_mutex_t shared_pool_lock = PTHREAD_MUTEX_INITIALIZER; // Held while a job runs on shared_pool
+static ThreadPool *shared_pool;
+
+// Function to run tasks on the calling thread plus up to nthreads - 1 workers of the shared pool
+static void run_parallel(size_t nthreads, PoolTask task, void *context, size_t task_count) {
+    if (nthreads <= 1 || task_count <= 1 || pthread_mutex_trylock(&shared_pool_lock) != 0) {
+        for (size_t i = 0; i < task_count; i++) {
+            task(context, i);
+        }
+        return;
+    }
+    if (!shared_pool || shared_pool->thread_count < nthreads - 1) {
+        if (shared_pool) free_thread_pool(shared_pool);
+        shared_pool = create_thread_pool(nthreads - 1);
+    }
+    thread_pool_dispatch(shared_pool, task, context, task_count, nthreads - 1);
+    pthread_mutex_unlock(&shared_pool_lock);
+}
+
+// Entries each parallel StringList task covers: 32 KB of 32-byte String structs, about a core's L1/L2 share
+#define STRING_LIST_CHUNK 1024
+
+// Define a struct to represent a string_list_map or string_list_filter job
+typedef struct {
+    StringList *list;
+    StringMapFn op;
+    StringPredicate predicate;
+    unsigned char *keep; // Filter verdict for every entry
+} ListJob;
+
+// Function to map one chunk of a list in place, a task of string_list_map
+static void map_chunk_task(void *context, size_t chunk) {
+    ListJob *job = (ListJob *)context;
+    size_t end = (chunk + 1) * STRING_LIST_CHUNK < job->list->size ? (chunk + 1) * STRING_LIST_CHUNK : job->list->size;
+    for (size_t i = chunk * STRING_LIST_CHUNK; i < end; i++) {
+        String mapped = job->op(&job->list->strings[i]);
+        free_string(&job->list->strings[i]);
+        job->list->strings[i] = mapped;
+    }
+}
+
+// Function to replace every entry of a list by op(entry), on up to nthreads threads
+// Entries keep their order; op must be safe to call from several threads at once
+void string_list_map(StringList *list, StringMapFn op, size_t nthreads) {
+    ListJob job = {list, op, NULL, NULL};
+    run_parallel(nthreads, map_chunk_task, &job, (list->size + STRING_LIST_CHUNK - 1) / STRING_LIST_CHUNK);
+}
+
+// Function to judge one chunk of a list and free the entries that go, a task of string_list_filter
+static void filter_chunk_task(void *context, size_t chunk) {
+    ListJob *job = (ListJob *)context;
+    size_t end = (chunk + 1) * STRING_LIST_CHUNK < job->list->size ? (chunk + 1) * STRING_LIST_CHUNK : job->list->size;
+    for (size_t i = chunk * STRING_LIST_CHUNK; i < end; i++) {
+        job->keep[i] = job->predicate(&job->list->strings[i]) != 0;
+        if (!job->keep[i]) free_string(&job->list->strings[i]);
+    }
+}
+
+// Function to keep only the entries a predicate accepts, in their order, on up to nthreads threads
+// The predicates run in parallel; the survivors are then moved together on the calling thread
+void string_list_filter(StringList *list, StringPredicate predicate, size_t nthreads) {
+    if (list->size == 0) return;
+
+    unsigned char *keep = (unsigned char *)tracked_realloc(NULL, 0, list->size);
+    ListJob job = {list, NULL, predicate, keep};
+    run_parallel(nthreads, filter_chunk_task, &job, (list->size + STRING_LIST_CHUNK - 1) / STRING_LIST_CHUNK);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < list->size; i++) {
+        if (keep[i]) list->strings[kept++] = list->strings[i];
+    }
+    tracked_free(keep, list->size);
+    list->size = kept;
+}
+
+// Parallel search
+//
+// parallel_find_all and parallel_count cut the haystack into PARALLEL_SEARCH_CHUNK-byte pieces
+// and search them as tasks on the shared thread pool. A piece owns the matches that start in it
+// and is searched needle length - 1 bytes past its end, so a match straddling a seam is found
+// exactly once, by the piece it starts in. Pieces are merged in order, so the offsets come out
+// sorted; they are size_t, so haystacks past 2 GB work (find_substring's int does not).
+
+// Bytes of haystack per parallel search task
+#define PARALLEL_SEARCH_CHUNK ((size_t)1 << 20)
+
+// Define a struct to represent a parallel_find_all or parallel_count job
+typedef struct {
+    StringView haystack;
+    StringView needle;
+    SearchKernel kernel;
+    size_t **matches; // Each piece's match offsets, relative to the piece, or NULL when only counting
+    size_t *counts;   // Each piece's number of matches
+} ParallelSearchJob;
+
+// Function to search one piece of the haystack, a task of parallel_find_all and parallel_count
+static void parallel_search_task(void *context, size_t piece) {
+    ParallelSearchJob *job = (ParallelSearchJob *)context;
+    size_t start = piece * PARALLEL_SEARCH_CHUNK;
+    size_t end = start + PARALLEL_SEARCH_CHUNK + job->needle.len - 1; // Overlap into the next piece
+    if (end > job->haystack.len) end = job->haystack.len;
+    StringView window = {job->haystack.ptr + start, end - start};
+
+    if (job->matches) {
+        job->matches[piece] = collect_search_matches(job->kernel, window, job->needle, &job->counts[piece]);
+        return;
+    }
+    size_t count = 0;
+    for (size_t pos = run_search_kernel(job->kernel, window, job->needle, 0); pos != STRING_NOT_FOUND;
+         pos = run_search_kernel(job->kernel, window, job->needle, pos + 1)) {
+        count++;
+    }
+    job->counts[piece] = count;
+}
+
+// Function to search every piece of a haystack on up to nthreads threads
+// Returns the number of pieces; the caller frees job->counts (and job->matches)
+static size_t parallel_search(ParallelSearchJob *job, const String *str, StringView needle, size_t nthreads, int collect) {
+    job->haystack = string_view(str);
+    job->needle = needle;
+    job->kernel = select_search_kernel(needle.len);
+    size_t pieces = (job->haystack.len + PARALLEL_SEARCH_CHUNK - 1) / PARALLEL_SEARCH_CHUNK;
+    job->counts = (size_t *)calloc(pieces ? pieces : 1, sizeof(size_t));
+    job->matches = collect ? (size_t **)calloc(pieces ? pieces : 1, sizeof(size_t *)) : NULL;
+    if (!job->counts || (collect && !job->matches)) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    if (needle.len > 0 && needle.len <= job->haystack.len) {
+        run_parallel(nthreads, parallel_search_task, job, pieces);
+    }
+    return pieces;
+}
+
+// Function to find the offsets of all (possibly overlapping) occurrences of needle, in order, on up to nthreads threads
+// Returns a malloc'd array (NULL when there are none) and sets *count; an empty needle matches nothing
+size_t* parallel_find_all(const String *str, StringView needle, size_t nthreads, size_t *count) {
+    STRING_TRACK_START(started);
+    ParallelSearchJob job;
+    size_t pieces = parallel_search(&job, str, needle, nthreads, 1);
+
+    size_t total = 0;
+    for (size_t piece = 0; piece < pieces; piece++) {
+        total += job.counts[piece];
+    }
+    size_t *matches = NULL;
+    if (total > 0) matches = (size_t *)tracked_realloc(NULL, 0, total * sizeof(size_t));
+    size_t size = 0;
+    for (size_t piece = 0; piece < pieces; piece++) {
+        for (size_t m = 0; m < job.counts[piece]; m++) {
+            matches[size++] = piece * PARALLEL_SEARCH_CHUNK + job.matches[piece][m];
+        }
+        free_match_offsets(job.matches[piece], job.counts[piece]);
+    }
+    free(job.matches);
+    free(job.counts);
+    *count = total;
+    STRING_TRACK_STOP(started, STRING_OP_FIND_ALL, job.haystack.len);
+    return matches;
+}
+
+// Function to count all (possibly overlapping) occurrences of needle on up to nthreads threads
+size_t parallel_count(const String *str, StringView needle, size_t nthreads) {
+    STRING_TRACK_START(started);
+    ParallelSearchJob job;
+    size_t pieces = parallel_search(&job, str, needle, nthreads, 0);
+
+    size_t total = 0;
+    for (size_t piece = 0; piece < pieces; piece++) {
+        total += job.counts[piece];
+    }
+    free(job.counts);
+    STRING_TRACK_STOP(started, STRING_OP_FIND_ALL, job.haystack.len);
+    return total;
+}
+
+// Formatting
+//
+// format_string and builder_appendf run vsnprintf straight into the free space of a builder
+// and only run it a second time, after growing the builder to the exact size it reported, when
+// the output did not fit. The integer and fixed-point appenders skip printf altogether: digits
+// are produced two at a time from a table of the 100 two-digit pairs, back to front.
+
+// "00" to "99", so one division by 100 yields two digits
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Function to write the decimal digits of value so that they end just before end, returns where they start
+static char *format_u64(char *end, uint64_t value) {
+    while (value >= 100) {
+        const char *pair = digit_pairs + (value % 100) * 2;
+        value /= 100;
+        *--end = pair[1];
+        *--end = pair[0];
+    }
+    if (value >= 10) {
+        *--end = digit_pairs[value * 2 + 1];
+        *--end = digit_pairs[value * 2];
+    } else {
+        *--end = (char)('0' + value);
+    }
+    return end;
+}
+
+// Function to get the rounding error of the product scaled = value * factor, exactly, without fma
+// Dekker's product: each factor is split into two 26-bit halves whose partial products are exact doubles
+static double scaled_product_error(double value, double factor, double scaled) {
+    double split = 134217729.0 * value; // 2^27 + 1
+    double value_high = split - (split - value), value_low = value - value_high;
+    split = 134217729.0 * factor;
+    double factor_high = split - (split - factor), factor_low = factor - factor_high;
+    return ((value_high * factor_high - scaled) + value_high * factor_low + value_low * factor_high) + value_low * factor_low;
+}
+
+// Function to format into the free space of a builder, growing it to the exact size and formatting again if needed
+static size_t builder_format(StringBuilder *builder, const char *format, va_list args) {
+    va_list retry;
+    va_copy(retry, args);
+    builder_reserve(builder, strlen(format)); // A guess that fits most short formats
+    size_t room = builder->capacity - builder->length;
+    int written = vsnprintf(builder->data + builder->length, room + 1, format, args); // +1: the buffer has room for the terminator
+    if (written > 0 && (size_t)written > room) {
+        builder_reserve(builder, (size_t)written);
+        vsnprintf(builder->data + builder->length, (size_t)written + 1, format, retry);
+    }
+    va_end(retry);
+    if (written < 0) return 0; // An encoding error, append nothing
+    builder->length += (size_t)written;
+    return (size_t)written;
+}
+
+// Function to append printf-style formatted text to a StringBuilder
+void builder_appendf(StringBuilder *builder, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    builder_vappendf(builder, format, args);
+    va_end(args);
+}
+
+// Function to append printf-style formatted text from a va_list to a StringBuilder
+void builder_vappendf(StringBuilder *builder, const char *format, va_list args) {
+    STRING_TRACK_START(started);
+    size_t written = builder_format(builder, format, args);
+    STRING_TRACK_STOP(started, STRING_OP_FORMAT, written);
+}
+
+// Function to append an unsigned integer in decimal to a StringBuilder
+void builder_append_uint(StringBuilder *builder, unsigned long long value) {
+    char digits[24];
+    char *p = format_u64(digits + sizeof(digits), value);
+    StringView view = {p, (size_t)(digits + sizeof(digits) - p)};
+    builder_append_view(builder, view);
+}
+
+// Function to append the fixed-point number value / 10^decimals, e.g. (12345, 2) as "123.45" and (-5, 3) as "-0.005"
+void builder_append_fixed(StringBuilder *builder, long long value, unsigned decimals) {
+    if (decimals == 0) {
+        builder_append_int(builder, value);
+        return;
+    }
+
+    char digits[48]; // Sign, up to 20 integer digits, the point and 19 decimals
+    char *end = digits + sizeof(digits);
+    unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    char *p = format_u64(end, magnitude);
+    if (decimals > 19) { // Every magnitude is below 10^20, so the integer part is 0 and zeros lead the digits
+        size_t zeros = decimals - (size_t)(end - p);
+        builder_append_cstr(builder, value < 0 ? "-0." : "0.");
+        builder_reserve(builder, zeros);
+        memset(builder->data + builder->length, '0', zeros);
+        builder->length += zeros;
+        StringView view = {p, (size_t)(end - p)};
+        builder_append_view(builder, view);
+        return;
+    }
+    while ((size_t)(end - p) < decimals + 1) {
+        *--p = '0'; // At least one integer digit and all the decimals
+    }
+    memmove(p - 1, p, (size_t)(end - p) - decimals); // Shift the integer digits left to open a gap for the point
+    end[-(long)decimals - 1] = '.';
+    p--;
+    if (value < 0) *--p = '-';
+
+    StringView view = {p, (size_t)(end - p)};
+    builder_append_view(builder, view);
+}
+
+// Function to append a double with a fixed number of decimals (at most 9), exactly like "%.*f" but without printf
+// The value is scaled by 10^decimals and rounded half to even. Below 2^52 the grid of scaled doubles holds every
+// half, so rounding the product can only turn a near-tie into an exact one; such ties, NaN, infinities and larger
+// magnitudes go through printf, which rounds the exact decimal value
+void builder_append_double(StringBuilder *builder, double value, unsigned decimals) {
+    static const double powers[10] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+    if (decimals > 9) {
+        builder_appendf(builder, "%.*f", (int)decimals, value);
+        return;
+    }
+    double scaled = value * powers[decimals];
+    if (!(scaled > -4503599627370496.0 && scaled < 4503599627370496.0)) { // 2^52; also false for NaN
+        builder_appendf(builder, "%.*f", (int)decimals, value);
+        return;
+    }
+    long long rounded = (long long)scaled; // Truncated towards zero
+    double fraction = scaled - (double)rounded;
+    if (fraction < 0) fraction = -fraction;
+    if (fraction == 0.5 && scaled_product_error(value, powers[decimals], scaled) != 0) {
+        builder_appendf(builder, "%.*f", (int)decimals, value); // A tie only after rounding the product
+        return;
+    }
+    if (fraction > 0.5 || (fraction == 0.5 && (rounded & 1))) rounded += scaled < 0 ? -1 : 1;
+    if (rounded == 0 && signbit(value)) builder_append_char(builder, '-'); // printf keeps the sign of values that round to zero, -0.0 too
+    builder_append_fixed(builder, rounded, decimals);
+}
+
+
+// Numeric parsing
+//
+// The parsers read an optional sign and decimal digits, stop at the first byte that cannot
+// continue the number and report how many bytes it took, so a field can be checked for
+// trailing garbage and a record can be scanned field after field. Nothing needs to be
+// null-terminated and no whitespace is skipped. Runs of digits are taken eight at a time:
+// eight bytes are loaded into one 64-bit word, checked for being all ASCII digits with two
+// masks and combined into their value with three multiplies. parse_double collects up to 19
+// significant digits the same way; when they fit in 53 bits and the power of ten is at most
+// 22, both are exact doubles and one multiply or divide rounds correctly (Clinger's fast
+// path). Longer or larger numbers are handed to strtod, which rounds correctly in the C locale.
+
+// Powers of ten that are exact doubles
+static const double exact_powers_of_ten[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Function to load 8 bytes as a word whose lowest byte is the first one
+static uint64_t load_digits_word(const char *p) {
+    uint64_t word;
+    memcpy(&word, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+// Function to check that all 8 bytes of a word are '0' to '9'
+// A byte is a digit when its high nibble is 3 and stays 3 after adding 6
+static int is_eight_digits(uint64_t word) {
+    return ((word & 0xF0F0F0F0F0F0F0F0ULL) | (((word + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ==
+           0x3333333333333333ULL;
+}
+
+// Function to turn 8 digit bytes, most significant in the lowest byte, into their value
+static uint32_t parse_eight_digits(uint64_t word) {
+    word -= 0x3030303030303030ULL;
+    word = word * 10 + (word >> 8); // Every other byte now holds a two-digit pair
+    word = (((word & 0x000000FF000000FFULL) * 0x000F424000000064ULL) +          // Pairs 0 and 2 times 10^6 and 100
+            (((word >> 16) & 0x000000FF000000FFULL) * 0x0000271000000001ULL)) >> 32; // Pairs 1 and 3 times 10^4 and 1
+    return (uint32_t)word;
+}
+
+// Function to read decimal digits into a 64-bit magnitude, which saturates at UINT64_MAX
+// Returns the number of digits read; *overflow is set when they did not fit
+static size_t parse_magnitude(const char *p, size_t len, uint64_t *magnitude, int *overflow) {
+    uint64_t value = 0;
+    size_t i = 0;
+    // Any 19 digits fit, so the first 16 can go eight at a time without checks
+    while (i + 8 <= len && i < 16) {
+        uint64_t word = load_digits_word(p + i);
+        if (!is_eight_digits(word)) {
+            break;
+        }
+        value = value * 100000000 + parse_eight_digits(word);
+        i += 8;
+    }
+    for (; i < len && (unsigned)(p[i] - '0') < 10; i++) {
+        unsigned digit = (unsigned)(p[i] - '0');
+        if (value > (UINT64_MAX - digit) / 10) {
+            value = UINT64_MAX;
+            *overflow = 1;
+        } else {
+            value = value * 10 + digit;
+        }
+    }
+    *magnitude = value;
+    return i;
+}
+
+// Function to parse an unsigned 64-bit integer at the start of text, with an optional '+'
+// consumed may be NULL; on PARSE_INVALID it is 0 and so is *value
+ParseStatus parse_u64(StringView text, uint64_t *value, size_t *consumed) {
+    size_t sign = text.len && text.ptr[0] == '+';
+    uint64_t magnitude;
+    int overflow = 0;
+    size_t digits = parse_magnitude(text.ptr + sign, text.len - sign, &magnitude, &overflow);
+    if (!digits) {
+        *value = 0;
+        if (consumed) *consumed = 0;
+        return PARSE_INVALID;
+    }
+    *value = magnitude;
+    if (consumed) *consumed = sign + digits;
+    return overflow ? PARSE_OVERFLOW : PARSE_OK;
+}
+
+// Function to parse a signed 64-bit integer at the start of text, with an optional '+' or '-'
+// consumed may be NULL; on PARSE_INVALID it is 0 and so is *value
+ParseStatus parse_i64(StringView text, int64_t *value, size_t *consumed) {
+    size_t sign = text.len && (text.ptr[0] == '-' || text.ptr[0] == '+');
+    int negative = sign && text.ptr[0] == '-';
+    uint64_t magnitude;
+    int overflow = 0;
+    size_t digits = parse_magnitude(text.ptr + sign, text.len - sign, &magnitude, &overflow);
+    if (!digits) {
+        *value = 0;
+        if (consumed) *consumed = 0;
+        return PARSE_INVALID;
+    }
+    if (consumed) *consumed = sign + digits;
+
+    uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+    if (overflow || magnitude > limit) {
+        *value = negative ? INT64_MIN : INT64_MAX;
+        return PARSE_OVERFLOW;
+    }
+    *value = negative ? -(int64_t)(magnitude - 1) - 1 : (int64_t)magnitude; // INT64_MIN has no positive counterpart
+    return PARSE_OK;
+}
+
+// Function to append decimal digits to a significand, eight at a time while they keep coming
+// Digits past the 19 that always fit are read but only set *truncated; returns the digits read
+static size_t parse_significand(const char *p, size_t len, uint64_t *significand, size_t *digits, int *truncated) {
+    uint64_t value = *significand;
+    size_t count = *digits;
+    size_t i = 0;
+    while (i + 8 <= len && count + 8 <= 19) {
+        uint64_t word = load_digits_word(p + i);
+        if (!is_eight_digits(word)) {
+            break;
+        }
+        value = value * 100000000 + parse_eight_digits(word);
+        count += 8;
+        i += 8;
+    }
+    for (; i < len && (unsigned)(p[i] - '0') < 10; i++) {
+        if (count < 19) {
+            value = value * 10 + (unsigned)(p[i] - '0');
+            count++;
+        } else {
+            *truncated = 1;
+        }
+    }
+    *significand = value;
+    *digits = count;
+    return i;
+}
+
+// Function to parse a decimal floating-point number at the start of text
+// Accepts an optional sign, digits with an optional '.', and an optional exponent ("1.5e-3");
+// at least one digit is required, and an 'e' without digits after it is left unconsumed.
+// consumed may be NULL; on PARSE_INVALID it is 0 and *value is 0. PARSE_OVERFLOW means the
+// number is too large for a double and *value is an infinity
+ParseStatus parse_double(StringView text, double *value, size_t *consumed) {
+    const char *p = text.ptr;
+    size_t len = text.len;
+    size_t i = 0;
+    int negative = 0;
+    if (i < len && (p[i] == '-' || p[i] == '+')) {
+        negative = p[i] == '-';
+        i++;
+    }
+
+    // Leading zeros carry no value, so they are skipped before significant digits are counted
+    size_t digits_seen = 0;
+    while (i < len && p[i] == '0') {
+        i++;
+        digits_seen++;
+    }
+    uint64_t significand = 0;
+    size_t digits = 0;
+    int truncated = 0;
+    size_t run = parse_significand(p + i, len - i, &significand, &digits, &truncated);
+    i += run;
+    digits_seen += run;
+
+    long long exponent = 0;
+    if (i < len && p[i] == '.') {
+        size_t fraction_start = ++i;
+        if (!digits) {
+            while (i < len && p[i] == '0') i++; // "0.000123" keeps only 123 as significant
+        }
+        i += parse_significand(p + i, len - i, &significand, &digits, &truncated);
+        exponent -= (long long)(i - fraction_start);
+        digits_seen += i - fraction_start;
+    }
+    if (!digits_seen) {
+        *value = 0;
+        if (consumed) *consumed = 0;
+        return PARSE_INVALID;
+    }
+
+    if (i < len && (p[i] == 'e' || p[i] == 'E')) {
+        size_t j = i + 1;
+        int exponent_negative = 0;
+        if (j < len && (p[j] == '-' || p[j] == '+')) {
+            exponent_negative = p[j] == '-';
+            j++;
+        }
+        if (j < len && (unsigned)(p[j] - '0') < 10) {
+            long long written = 0;
+            for (; j < len && (unsigned)(p[j] - '0') < 10; j++) {
+                if (written < 100000) written = written * 10 + (p[j] - '0'); // Far past any double's range already
+            }
+            exponent += exponent_negative ? -written : written;
+            i = j;
+        }
+    }
+    if (consumed) *consumed = i;
+
+    // Only exact where every operation rounds to double, which excess precision (x87) breaks
+#if FLT_EVAL_METHOD == 0
+    if (!truncated && significand <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+        double result = (double)significand;
+        result = exponent < 0 ? result / exact_powers_of_ten[-exponent] : result * exact_powers_of_ten[exponent];
+        *value = negative ? -result : result;
+        return PARSE_OK;
+    }
+#endif
+
+    // strtod needs the number null-terminated, and only gets the bytes parsed above
+    char local[64];
+    char *copy = i < sizeof(local) ? local : (char *)malloc(i + 1);
+    if (!copy) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, p, i);
+    copy[i] = '\0';
+    *value = strtod(copy, NULL);
+    if (copy != local) {
+        free(copy);
+    }
+    return *value > DBL_MAX || *value < -DBL_MAX ? PARSE_OVERFLOW : PARSE_OK;
+}
+
+// Function to parse every entry of a column, such as one field of each split CSV record
+// out must have room for column->size elements of the type named by type (int64_t, uint64_t
+// or double). Each entry must be a number and nothing else; entries that are not hold 0, and
+// entries out of range hold the clamped value. Returns PARSE_OK, or the status of the first
+// entry that failed, whose position goes to *error_index when it is not NULL
+ParseStatus parse_column(const StringList *column, ParseType type, void *out, size_t *error_index) {
+    STRING_TRACK_START(started);
+    ParseStatus result = PARSE_OK;
+    size_t bytes = 0;
+    for (size_t i = 0; i < column->size; i++) {
+        StringView field = string_view(&column->strings[i]);
+        size_t consumed;
+        ParseStatus status;
+        switch (type) {
+        case PARSE_I64:
+            status = parse_i64(field, (int64_t *)out + i, &consumed);
+            if (status != PARSE_INVALID && consumed != field.len) ((int64_t *)out)[i] = 0;
+            break;
+        case PARSE_U64:
+            status = parse_u64(field, (uint64_t *)out + i, &consumed);
+            if (status != PARSE_INVALID && consumed != field.len) ((uint64_t *)out)[i] = 0;
+            break;
+        default:
+            status = parse_double(field, (double *)out + i, &consumed);
+            if (status != PARSE_INVALID && consumed != field.len) ((double *)out)[i] = 0;
+            break;
+        }
+        if (consumed != field.len) {
+            status = PARSE_INVALID; // Empty, or a number followed by something else
+        }
+        if (status != PARSE_OK && result == PARSE_OK) {
+            result = status;
+            if (error_index) *error_index = i;
+        }
+        bytes += field.len;
+    }
+    STRING_TRACK_STOP(started, STRING_OP_PARSE, bytes);
+    return result;
+}
+
+
+// UTF-8
+//
+// Strings stay byte strings; these functions read them as UTF-8 on request. A code point is
+// counted at every byte that is not a continuation byte (10xxxxxx), so counting, substring and
+// reverse agree with each other even on invalid input, where each stray byte is a unit of its
+// own. Validation with SSSE3 or AVX2 follows Keiser and Lemire: three 16-entry tables, indexed
+// by the high and low nibble of the previous byte and the high nibble of the current one, are
+// ANDed to flag every invalid two-byte pattern, and a saturating subtract checks that the third
+// and fourth bytes of long sequences are continuations. Blocks of pure ASCII only check that no
+// sequence was left open by the block before. When a block fails, the scalar validator takes
+// over from the last sequence boundary to find the exact offset. Case mapping needs no variant:
+// the case maps only touch ASCII letters and leave every byte of a multi-byte sequence alone.
+
+// Function to check whether a byte continues a multi-byte sequence
+static int utf8_is_continuation(unsigned char byte) {
+    return (byte & 0xC0) == 0x80;
+}
+
+// Function to step back from a block start to the start of the sequence crossing into it
+// Everything before from is known to be valid, so at most three continuation bytes precede it
+static size_t utf8_sequence_start(const unsigned char *data, size_t from) {
+    size_t start = from;
+    while (start > 0 && from - start < 3 && utf8_is_continuation(data[start - 1])) start--;
+    if (start > 0 && data[start - 1] >= 0xC0) return start - 1;
+    return from;
+}
+
+// Function to validate UTF-8 one sequence at a time, skipping ASCII 8 bytes per step
+// Returns the offset of the first invalid or truncated sequence, or STRING_NOT_FOUND
+static size_t utf8_validate_scalar(const unsigned char *data, size_t length, size_t from) {
+    size_t i = from;
+    while (i < length) {
+        if (i + 8 <= length) {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            if (!(word & 0x8080808080808080ULL)) {
+                i += 8;
+                continue;
+            }
+        }
+        unsigned char byte = data[i];
+        if (byte < 0x80) {
+            i++;
+            continue;
+        }
+        size_t need;
+        unsigned char low = 0x80, high = 0xBF; // Allowed range of the first continuation byte
+        if (byte >= 0xC2 && byte <= 0xDF) {
+            need = 1;
+        } else if (byte >= 0xE0 && byte <= 0xEF) {
+            need = 2;
+            if (byte == 0xE0) low = 0xA0;  // Overlong
+            if (byte == 0xED) high = 0x9F; // Surrogates
+        } else if (byte >= 0xF0 && byte <= 0xF4) {
+            need = 3;
+            if (byte == 0xF0) low = 0x90;  // Overlong
+            if (byte == 0xF4) high = 0x8F; // Past U+10FFFF
+        } else {
+            return i; // Stray continuation, overlong two-byte lead or a byte UTF-8 never uses
+        }
+        if (length - i <= need || data[i + 1] < low || data[i + 1] > high) return i;
+        for (size_t k = 2; k <= need; k++) {
+            if (!utf8_is_continuation(data[i + k])) return i;
+        }
+        i += need + 1;
+    }
+    return STRING_NOT_FOUND;
+}
+
+#ifdef STRING_HAVE_X86_SIMD
+// Flags of the invalid patterns the lookup tables detect, per pair of adjacent bytes
+#define UTF8_TOO_SHORT (1 << 0)      // Lead byte followed by a lead or ASCII byte
+#define UTF8_TOO_LONG (1 << 1)       // ASCII byte followed by a continuation byte
+#define UTF8_OVERLONG_3 (1 << 2)     // E0 followed by 80..9F
+#define UTF8_TOO_LARGE (1 << 3)      // F4 followed by 90..BF, or F5..FF followed by 90..BF
+#define UTF8_SURROGATE (1 << 4)      // ED followed by A0..BF
+#define UTF8_OVERLONG_2 (1 << 5)     // C0 or C1 followed by a continuation byte
+#define UTF8_TOO_LARGE_1000 (1 << 6) // F5..FF followed by 80..8F
+#define UTF8_OVERLONG_4 (1 << 6)     // F0 followed by 80..8F
+#define UTF8_TWO_CONTS (1 << 7)      // Two continuation bytes where the first ends a sequence
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS) // Patterns decided by the high nibbles alone
+
+// Table indexed by the high nibble of the previous byte
+static const signed char utf8_table_prev_high[16] = {
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+    (signed char)UTF8_TWO_CONTS, (signed char)UTF8_TWO_CONTS, (signed char)UTF8_TWO_CONTS, (signed char)UTF8_TWO_CONTS,
+    UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+    UTF8_TOO_SHORT,
+    UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+    UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+};
+
+// Table indexed by the low nibble of the previous byte
+static const signed char utf8_table_prev_low[16] = {
+    (signed char)(UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4),
+    (signed char)(UTF8_CARRY | UTF8_OVERLONG_2),
+    (signed char)UTF8_CARRY,
+    (signed char)UTF8_CARRY,
+    (signed char)(UTF8_CARRY | UTF8_TOO_LARGE),
+    (signed char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+    (signed char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+    (signed char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+    (signed char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+    (signed char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+    (signed char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+    (signed char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+    (signed char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+    (signed char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE),
+    (signed char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000),
+    (signed char)(UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000)
+};
+
+// Table indexed by the high nibble of the current byte
+static const signed char utf8_table_current_high[16] = {
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+    (signed char)(UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4),
+    (signed char)(UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE),
+    (signed char)(UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE),
+    (signed char)(UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE),
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+};
+
+// Function to validate UTF-8 16 bytes per step with SSSE3 table lookups
+// Returns the start of the first block that failed, or of the bytes left over after the last block
+__attribute__((target("ssse3")))
+static size_t utf8_validate_ssse3(const unsigned char *data, size_t length) {
+    const __m128i prev_high_table = _mm_loadu_si128((const __m128i *)utf8_table_prev_high);
+    const __m128i prev_low_table = _mm_loadu_si128((const __m128i *)utf8_table_prev_low);
+    const __m128i current_high_table = _mm_loadu_si128((const __m128i *)utf8_table_current_high);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    // Any byte above these in the last three positions opens a sequence the next block must close
+    const __m128i incomplete_limit = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                   (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+    __m128i previous = _mm_setzero_si128();
+    __m128i incomplete = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i input = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i error;
+        if (!_mm_movemask_epi8(input)) {
+            error = incomplete; // Pure ASCII: only a sequence left open before it can be wrong
+            incomplete = _mm_setzero_si128();
+        } else {
+            __m128i prev1 = _mm_alignr_epi8(input, previous, 15);
+            __m128i special = _mm_and_si128(
+                _mm_and_si128(_mm_shuffle_epi8(prev_high_table, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                              _mm_shuffle_epi8(prev_low_table, _mm_and_si128(prev1, nibble))),
+                _mm_shuffle_epi8(current_high_table, _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+            __m128i prev2 = _mm_alignr_epi8(input, previous, 14);
+            __m128i prev3 = _mm_alignr_epi8(input, previous, 13);
+            __m128i third = _mm_subs_epu8(prev2, _mm_set1_epi8((char)(0xE0 - 0x80)));  // >= 0x80 only after a 3- or 4-byte lead
+            __m128i fourth = _mm_subs_epu8(prev3, _mm_set1_epi8((char)(0xF0 - 0x80))); // >= 0x80 only after a 4-byte lead
+            __m128i must_continue = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8((char)0x80));
+            error = _mm_xor_si128(must_continue, special);
+            incomplete = _mm_subs_epu8(input, incomplete_limit);
+        }
+        previous = input;
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) != 0xFFFF) break;
+    }
+    return i;
+}
+
+// Function to validate UTF-8 32 bytes per step with AVX2 table lookups
+__attribute__((target("avx2")))
+static size_t utf8_validate_avx2(const unsigned char *data, size_t length) {
+    const __m256i prev_high_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)utf8_table_prev_high));
+    const __m256i prev_low_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)utf8_table_prev_low));
+    const __m256i current_high_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)utf8_table_current_high));
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i incomplete_limit = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                      (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+    __m256i previous = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i error;
+        if (!_mm256_movemask_epi8(input)) {
+            error = incomplete;
+            incomplete = _mm256_setzero_si256();
+        } else {
+            // alignr works per 128-bit lane, so the lane below each byte comes from a permute
+            __m256i shifted = _mm256_permute2x128_si256(previous, input, 0x21);
+            __m256i prev1 = _mm256_alignr_epi8(input, shifted, 15);
+            __m256i special = _mm256_and_si256(
+                _mm256_and_si256(_mm256_shuffle_epi8(prev_high_table, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                                 _mm256_shuffle_epi8(prev_low_table, _mm256_and_si256(prev1, nibble))),
+                _mm256_shuffle_epi8(current_high_table, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+            __m256i prev2 = _mm256_alignr_epi8(input, shifted, 14);
+            __m256i prev3 = _mm256_alignr_epi8(input, shifted, 13);
+            __m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80)));
+            __m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80)));
+            __m256i must_continue = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+            error = _mm256_xor_si256(must_continue, special);
+            incomplete = _mm256_subs_epu8(input, incomplete_limit);
+        }
+        previous = input;
+        if (!_mm256_testz_si256(error, error)) break;
+    }
+    return i;
+}
+
+// Function to count the bytes that start a code point, 16 per step with SSE2
+__attribute__((target("sse2")))
+static size_t utf8_count_sse2(const unsigned char *data, size_t length, size_t *done) {
+    const __m128i last_continuation = _mm_set1_epi8((char)0xBF); // -65: continuation bytes are -128..-65 as signed
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i input = _mm_loadu_si128((const __m128i *)(data + i));
+        count += (size_t)__builtin_popcount((unsigned)_mm_movemask_epi8(_mm_cmpgt_epi8(input, last_continuation)));
+    }
+    *done = i;
+    return count;
+}
+
+// Function to count the bytes that start a code point, 32 per step with AVX2
+__attribute__((target("avx2,popcnt")))
+static size_t utf8_count_avx2(const unsigned char *data, size_t length, size_t *done) {
+    const __m256i last_continuation = _mm256_set1_epi8((char)0xBF);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i *)(data + i));
+        count += (size_t)__builtin_popcount((unsigned)_mm256_movemask_epi8(_mm256_cmpgt_epi8(input, last_continuation)));
+    }
+    *done = i;
+    return count;
+}
+
+// Function to OR every byte together, 32 per step with AVX2; the result has 0x80 set unless all were ASCII
+__attribute__((target("avx2")))
+static int utf8_has_high_bit_avx2(const unsigned char *data, size_t length, size_t *done) {
+    __m256i any = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        any = _mm256_or_si256(any, _mm256_loadu_si256((const __m256i *)(data + i)));
+    }
+    *done = i;
+    return _mm256_movemask_epi8(any) != 0;
+}
+
+// Function to OR every byte together, 16 per step with SSE2
+__attribute__((target("sse2")))
+static int utf8_has_high_bit_sse2(const unsigned char *data, size_t length, size_t *done) {
+    __m128i any = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        any = _mm_or_si128(any, _mm_loadu_si128((const __m128i *)(data + i)));
+    }
+    *done = i;
+    return _mm_movemask_epi8(any) != 0;
+}
+#endif
+
+// Function to check whether every byte of a view is ASCII, in one pass
+int is_ascii(StringView text) {
+    const unsigned char *data = (const unsigned char *)text.ptr;
+    size_t i = 0;
+#ifdef STRING_HAVE_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        if (utf8_has_high_bit_avx2(data, text.len, &i)) return 0;
+    } else if (__builtin_cpu_supports("sse2")) {
+        if (utf8_has_high_bit_sse2(data, text.len, &i)) return 0;
+    }
+#endif
+    uint64_t any = 0;
+    for (; i + 8 <= text.len; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        any |= word;
+    }
+    for (; i < text.len; i++) any |= data[i];
+    return !(any & 0x8080808080808080ULL);
+}
+
+// Function to check that a view is well-formed UTF-8 (no overlongs, surrogates or values past U+10FFFF)
+// On failure the offset of the first invalid or truncated sequence goes to *error_offset, if not NULL
+int utf8_validate(StringView text, size_t *error_offset) {
+    const unsigned char *data = (const unsigned char *)text.ptr;
+    size_t from = 0;
+#ifdef STRING_HAVE_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        from = utf8_validate_avx2(data, text.len);
+    } else if (__builtin_cpu_supports("ssse3")) {
+        from = utf8_validate_ssse3(data, text.len);
+    }
+#endif
+    // Whether a block failed or the input ran out, the scalar pass picks up at the sequence
+    // crossing into the first untrusted byte: it finishes the tail or pins down the error
+    size_t error = utf8_validate_scalar(data, text.len, utf8_sequence_start(data, from));
+    if (error == STRING_NOT_FOUND) return 1;
+    if (error_offset) *error_offset = error;
+    return 0;
+}
+
+// Function to count the code points of a view; each byte that is not a continuation byte starts one
+size_t utf8_count(StringView text) {
+    const unsigned char *data = (const unsigned char *)text.ptr;
+    size_t count = 0;
+    size_t i = 0;
+#ifdef STRING_HAVE_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        count = utf8_count_avx2(data, text.len, &i);
+    } else if (__builtin_cpu_supports("sse2")) {
+        count = utf8_count_sse2(data, text.len, &i);
+    }
+#endif
+    for (; i < text.len; i++) {
+        count += !utf8_is_continuation(data[i]);
+    }
+    return count;
+}
+
+// Function to find the byte offset of code point index, or the length of the view if it has no more
+// Whole words are skipped by counting their continuation bytes 8 at a time
+static size_t utf8_offset(StringView text, size_t index) {
+    const unsigned char *data = (const unsigned char *)text.ptr;
+    size_t i = 0;
+    while (i + 8 <= text.len) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        size_t continuations = (size_t)__builtin_popcountll(word & ~(word << 1) & 0x8080808080808080ULL); // 10xxxxxx
+        if (8 - continuations > index) break;
+        index -= 8 - continuations;
+        i += 8;
+    }
+    for (; i < text.len; i++) {
+        if (utf8_is_continuation(data[i])) continue;
+        if (index == 0) return i;
+        index--;
+    }
+    return text.len;
+}
+
+// Function to get the length of a String in code points
+size_t get_string_utf8_length(const String *str) {
+    return str ? utf8_count(string_view(str)) : 0;
+}
+
+// Function to create a substring of length code points starting at code point start
+// Never cuts a code point in half; only the bytes up to the end of the substring are read
+String utf8_substring(const String *str, size_t start, size_t length) {
+    if (!str) return create_string("");
+
+    StringView view = string_view(str);
+    size_t first = utf8_offset(view, start);
+    StringView rest = {view.ptr + first, view.len - first};
+    return substring(str, first, utf8_offset(rest, length));
+}
+
+// Function to reverse the code points of a string, keeping the bytes of each one in order
+// Pure-ASCII input takes the byte path directly; combining marks are not kept with their base
+String utf8_reverse_string(const String *str) {
+    if (!str || !string_data(str)) return create_string("");
+
+    StringView view = string_view(str);
+    if (is_ascii(view)) return reverse_string(str);
+
+    STRING_TRACK_START(started);
+    String reversed = string_alloc_in(NULL, str->length);
+    const unsigned char *src = (const unsigned char *)view.ptr;
+    char *dest = string_data(&reversed);
+    for (size_t i = 0; i < view.len;) {
+        size_t unit = 1;
+        while (unit < 4 && i + unit < view.len && utf8_is_continuation(src[i + unit])) unit++;
+        memcpy(dest + view.len - i - unit, src + i, unit);
+        i += unit;
+    }
+    STRING_TRACK_STOP(started, STRING_OP_REVERSE, str->length);
+    return reversed;
+}
+
+
+// Edit distance and fuzzy search
+//
+// edit_distance is the Levenshtein distance, computed with Myers' bit-vector algorithm: one
+// column of the DP matrix is held as bit vectors of its +1 and -1 vertical steps, so each byte
+// of the other string costs a few word operations instead of a column of cells. That needs the
+// shorter string to fit in 64 bits; longer pairs fill only the diagonal band of width
+// 2 * max_k + 1, which is all a bounded distance depends on. Both give up as soon as the
+// distance can no longer come back under max_k. fuzzy_find compiles the query's bit vectors
+// once and puts every entry through two cheap filters before computing a distance: the
+// lengths may differ by at most k, and the entry must share at least max(lengths) - 1 - 2k
+// bigrams with the query, since one edit destroys at most two of them.
+
+// Buckets the bigram filter hashes byte pairs into; collisions only let more entries through
+#define FUZZY_BIGRAM_BUCKETS 4096
+
+// Define a struct to represent a pattern of up to 64 bytes compiled for myers_distance
+typedef struct {
+    uint64_t peq[256]; // Bit i of peq[c] is set when byte i of the pattern is c
+    size_t length;
+} MyersPattern;
+
+// Define a struct to represent a fuzzy_find job
+typedef struct {
+    const StringList *list;
+    StringView query;
+    size_t k;
+    const MyersPattern *pattern;    // The compiled query, or NULL when it is longer than 64 bytes
+    const unsigned *bigrams;        // How often each bigram bucket occurs in the query
+    FuzzyMatch **matches;           // Each chunk's matches
+    size_t *counts;                 // Each chunk's number of matches
+} FuzzyJob;
+
+// Function to compile a pattern of at most 64 bytes
+static void myers_compile(MyersPattern *pattern, StringView text) {
+    memset(pattern->peq, 0, sizeof(pattern->peq));
+    for (size_t i = 0; i < text.len; i++) {
+        pattern->peq[(unsigned char)text.ptr[i]] |= 1ULL << i;
+    }
+    pattern->length = text.len;
+}
+
+// Function to compute the edit distance between a compiled pattern and a text with Myers' algorithm
+// Returns max_k + 1 as soon as the distance is known to exceed max_k
+static size_t myers_distance(const MyersPattern *pattern, StringView text, size_t max_k) {
+    size_t m = pattern->length;
+    size_t n = text.len;
+    if (max_k > (m > n ? m : n)) max_k = m > n ? m : n; // The distance never exceeds the longer length; keeps max_k + 1 from wrapping
+    if (m == 0) return n <= max_k ? n : max_k + 1;
+
+    uint64_t pv = ~0ULL; // Vertical +1 steps; only the low m bits matter, carries never flow downward
+    uint64_t mv = 0;     // Vertical -1 steps
+    uint64_t last = 1ULL << (m - 1);
+    size_t score = m;    // Bottom cell of the current column
+    for (size_t j = 0; j < n; j++) {
+        uint64_t eq = pattern->peq[(unsigned char)text.ptr[j]];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & last) {
+            score++;
+        } else if (mh & last) {
+            score--;
+        }
+        ph = (ph << 1) | 1; // The top row grows by one per column: the whole prefix of text is inserted
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+        if (score > max_k + (n - j - 1)) return max_k + 1; // Each remaining byte lowers it by at most one
+    }
+    return score <= max_k ? score : max_k + 1;
+}
+
+// Function to compute a bounded edit distance by filling only the band |i - j| <= max_k of the DP
+// a is the shorter string; rows has room for two rows of b.len + 1 cells; cells past max_k are all stored as max_k + 1
+static size_t banded_distance(StringView a, StringView b, size_t max_k, size_t *rows) {
+    size_t over = max_k + 1;
+    size_t *previous = rows;
+    size_t *current = rows + b.len + 1;
+    for (size_t j = 0; j <= b.len; j++) {
+        previous[j] = j < over ? j : over;
+    }
+
+    for (size_t i = 1; i <= a.len; i++) {
+        size_t low = i > max_k ? i - max_k : 1;
+        size_t high = i + max_k < b.len ? i + max_k : b.len;
+        current[low - 1] = low == 1 && i < over ? i : over;
+        size_t row_min = current[low - 1];
+        for (size_t j = low; j <= high; j++) {
+            size_t best = previous[j - 1] + (a.ptr[i - 1] != b.ptr[j - 1]);
+            if (previous[j] + 1 < best) best = previous[j] + 1;
+            if (current[j - 1] + 1 < best) best = current[j - 1] + 1;
+            current[j] = best < over ? best : over;
+            if (current[j] < row_min) row_min = current[j];
+        }
+        if (high < b.len) current[high + 1] = over; // Read as "above" by the next row
+        if (row_min >= over) return over;           // Every path already costs too much
+        size_t *swap = previous;
+        previous = current;
+        current = swap;
+    }
+    return previous[b.len];
+}
+
+// Function to compute a bounded edit distance, taking the DP rows of long strings from a buffer the caller
+// keeps across calls and frees; *rows grows to fit, so a run of comparisons allocates only a few times
+static size_t edit_distance_rows(StringView a, StringView b, size_t max_k, size_t **rows, size_t *row_capacity) {
+    if (a.len > b.len) {
+        StringView swap = a;
+        a = b;
+        b = swap;
+    }
+    if (max_k > b.len) max_k = b.len; // The distance never exceeds the longer length
+    if (b.len - a.len > max_k) return max_k + 1;
+
+    if (a.len <= 64) {
+        MyersPattern pattern;
+        myers_compile(&pattern, a);
+        return myers_distance(&pattern, b, max_k);
+    }
+    if (*row_capacity < 2 * (b.len + 1)) {
+        while (*row_capacity < 2 * (b.len + 1)) {
+            *row_capacity = *row_capacity ? *row_capacity * 2 : 256; // Double the capacity
+        }
+        free(*rows);
+        *rows = (size_t *)malloc(*row_capacity * sizeof(size_t));
+        if (!*rows) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return banded_distance(a, b, max_k, *rows);
+}
+
+// Function to compute the Levenshtein distance between two strings, bounded by max_k
+// Returns the distance if it is at most max_k and max_k + 1 otherwise; pass SIZE_MAX for no bound
+size_t edit_distance(StringView a, StringView b, size_t max_k) {
+    size_t *rows = NULL;
+    size_t row_capacity = 0;
+    size_t distance = edit_distance_rows(a, b, max_k, &rows, &row_capacity);
+    free(rows);
+    return distance;
+}
+
+// Function to get the bucket of the bigram starting at p
+static unsigned fuzzy_bigram(const char *p) {
+    return (((unsigned)(unsigned char)p[0] << 4) ^ (unsigned char)p[1]) & (FUZZY_BIGRAM_BUCKETS - 1);
+}
+
+// Function to search one chunk of the list, a task of fuzzy_find
+static void fuzzy_chunk_task(void *context, size_t chunk) {
+    FuzzyJob *job = (FuzzyJob *)context;
+    size_t end = (chunk + 1) * STRING_LIST_CHUNK < job->list->size ? (chunk + 1) * STRING_LIST_CHUNK : job->list->size;
+    unsigned seen[FUZZY_BIGRAM_BUCKETS] = {0}; // Bigrams of the current entry matched so far
+    FuzzyMatch *matches = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    size_t *rows = NULL; // DP rows for queries longer than 64 bytes, shared by every entry of the chunk
+    size_t row_capacity = 0;
+
+    for (size_t i = chunk * STRING_LIST_CHUNK; i < end; i++) {
+        StringView entry = string_view(&job->list->strings[i]);
+        size_t longer = entry.len > job->query.len ? entry.len : job->query.len;
+        size_t shorter = entry.len + job->query.len - longer;
+        size_t k = job->k < longer ? job->k : longer; // The distance never exceeds the longer length, so 2 * k + 1 cannot wrap
+        if (longer - shorter > k) continue;
+
+        if (longer > 2 * k + 1) {
+            size_t needed = longer - 1 - 2 * k;
+            size_t shared = 0;
+            for (size_t p = 0; p + 1 < entry.len; p++) {
+                unsigned bucket = fuzzy_bigram(entry.ptr + p);
+                if (seen[bucket] < job->bigrams[bucket]) shared++;
+                seen[bucket]++;
+            }
+            for (size_t p = 0; p + 1 < entry.len; p++) {
+                seen[fuzzy_bigram(entry.ptr + p)] = 0;
+            }
+            if (shared < needed) continue;
+        }
+
+        size_t distance = job->pattern ? myers_distance(job->pattern, entry, k)
+                                       : edit_distance_rows(job->query, entry, k, &rows, &row_capacity);
+        if (distance > k) continue;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 16; // Double the capacity
+            matches = (FuzzyMatch *)realloc(matches, capacity * sizeof(FuzzyMatch));
+            if (!matches) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        matches[count].index = i;
+        matches[count].distance = distance;
+        count++;
+    }
+    free(rows);
+    job->matches[chunk] = matches;
+    job->counts[chunk] = count;
+}
+
+// Function to order fuzzy matches by distance, then by position in the list
+static int compare_fuzzy_matches(const void *a, const void *b) {
+    const FuzzyMatch *x = (const FuzzyMatch *)a;
+    const FuzzyMatch *y = (const FuzzyMatch *)b;
+    if (x->distance != y->distance) return x->distance < y->distance ? -1 : 1;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+// Function to find every entry of a list within edit distance k of query, on up to nthreads threads
+// Returns the matches ranked by distance and then by index (NULL if there are none); the caller frees them
+FuzzyMatch *fuzzy_find(const StringList *list, StringView query, size_t k, size_t nthreads, size_t *count) {
+    STRING_TRACK_START(started);
+    MyersPattern pattern;
+    if (query.len <= 64) myers_compile(&pattern, query);
+    unsigned *bigrams = (unsigned *)calloc(FUZZY_BIGRAM_BUCKETS, sizeof(unsigned));
+    size_t chunks = (list->size + STRING_LIST_CHUNK - 1) / STRING_LIST_CHUNK;
+    FuzzyJob job = {list, query, k, query.len <= 64 ? &pattern : NULL, bigrams,
+                    (FuzzyMatch **)calloc(chunks ? chunks : 1, sizeof(FuzzyMatch *)),
+                    (size_t *)calloc(chunks ? chunks : 1, sizeof(size_t))};
+    if (!bigrams || !job.matches || !job.counts) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t p = 0; p + 1 < query.len; p++) {
+        unsigned bucket = fuzzy_bigram(query.ptr + p);
+        bigrams[bucket]++;
+    }
+    run_parallel(nthreads, fuzzy_chunk_task, &job, chunks);
+
+    size_t total = 0;
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        total += job.counts[chunk];
+    }
+    FuzzyMatch *matches = NULL;
+    if (total > 0) {
+        matches = (FuzzyMatch *)malloc(total * sizeof(FuzzyMatch));
+        if (!matches) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    size_t size = 0;
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        if (job.counts[chunk]) memcpy(matches + size, job.matches[chunk], job.counts[chunk] * sizeof(FuzzyMatch));
+        size += job.counts[chunk];
+        free(job.matches[chunk]);
+    }
+    if (total > 1) qsort(matches, total, sizeof(FuzzyMatch), compare_fuzzy_matches);
+    free(job.matches);
+    free(job.counts);
+    free(bigrams);
+    *count = total;
+    STRING_TRACK_STOP(started, STRING_OP_FUZZY_FIND, list->size);
+    return matches;
+}
+
+
+// Glob patterns
+//
+// compile_pattern turns a glob into a DFA once, so match_pattern reads each byte of the input
+// with one table lookup and never backtracks. The glob is first a row of items, each a '*' or a
+// set of bytes, and a state of the match is the set of items reached so far. Bytes that no item
+// tells apart share one class, and PATTERN_CASE_INSENSITIVE adds the other case of every letter
+// to every set, which folds the two cases into one class and makes the mode free at match time.
+// The DFA is then built by subset construction over the classes. Once a '*' is reached the items
+// before it can only lead back to it, so they are dropped from the set; that keeps the DFA to
+// a few states per literal byte for patterns like *error*timeout*. A glob that still needs more
+// than PATTERN_MAX_STATES states is instead matched by stepping its set of items as a bit vector
+// over the input, which is slower but still a single pass. A glob made only of '*' and literal
+// bytes, *error*timeout* among them, skips the table altogether: its literals are prepared as
+// StringSearchers and found one after another, so the SIMD kernels pass over the bytes that
+// cannot start a literal instead of the DFA stepping through each of them.
+
+// Most DFA states compile_pattern builds before falling back to stepping the item sets
+#define PATTERN_MAX_STATES 4096
+
+// Words of item set match_pattern keeps on the stack when stepping; globs of up to 511 items need no allocation
+#define PATTERN_STACK_WORDS 8
+
+// Define a struct to represent a string_list_select job
+typedef struct {
+    const StringList *list;
+    const CompiledPattern *pattern;
+    unsigned char *keep; // Verdict for every entry
+} SelectJob;
+
+// Function to add a byte to a 256-bit set, and with case folding the other case of an ASCII letter too
+static void pattern_set_add(uint64_t set[4], unsigned char byte, int flags) {
+    set[byte >> 6] |= 1ULL << (byte & 63);
+    if (!(flags & PATTERN_CASE_INSENSITIVE)) return;
+    if (byte >= 'a' && byte <= 'z') byte = (unsigned char)(byte - 'a' + 'A');
+    else if (byte >= 'A' && byte <= 'Z') byte = (unsigned char)(byte - 'A' + 'a');
+    set[byte >> 6] |= 1ULL << (byte & 63); // Independent of the locale, like the case byte maps
+}
+
+// Function to parse a bracket expression starting after its '[' into a byte set
+// Returns the number of glob bytes it used including the closing ']', or 0 if it is never closed
+static size_t pattern_parse_bracket(const char *glob, uint64_t set[4], int flags) {
+    uint64_t found[4] = {0, 0, 0, 0};
+    size_t i = 0;
+    int negate = glob[i] == '!' || glob[i] == '^';
+    if (negate) i++;
+    for (int first = 1; glob[i] && (first || glob[i] != ']'); first = 0) {
+        unsigned char low = (unsigned char)glob[i++];
+        if (low == '\\' && glob[i]) low = (unsigned char)glob[i++];
+        unsigned char high = low;
+        if (glob[i] == '-' && glob[i + 1] && glob[i + 1] != ']') {
+            i++;
+            high = (unsigned char)glob[i++];
+            if (high == '\\' && glob[i]) high = (unsigned char)glob[i++];
+        }
+        for (unsigned byte = low; byte <= high; byte++) {
+            pattern_set_add(found, (unsigned char)byte, flags);
+        }
+    }
+    if (!glob[i]) return 0; // The '[' is then an ordinary byte
+
+    for (int w = 0; w < 4; w++) {
+        set[w] = negate ? ~found[w] : found[w];
+    }
+    return i + 1;
+}
+
+// Function to add the items right after every '*' in a set, since a '*' also matches nothing,
+// then drop the items before the last '*', which can only lead back to it
+// Returns whether any item is left
+static int pattern_close(const CompiledPattern *pattern, uint64_t *set) {
+    uint64_t carry = 0;
+    for (size_t w = 0; w < pattern->words; w++) {
+        uint64_t stars = set[w] & pattern->stars[w];
+        set[w] |= (stars << 1) | carry; // Never another '*': runs of them are merged when compiling
+        carry = stars >> 63;
+    }
+
+    size_t w = pattern->words;
+    while (w > 0 && !(set[w - 1] & pattern->stars[w - 1])) {
+        w--;
+    }
+    if (w > 0) {
+        uint64_t stars = set[w - 1] & pattern->stars[w - 1];
+        uint64_t last = 1ULL << (63 - __builtin_clzll(stars));
+        set[w - 1] &= ~(last - 1);
+        memset(set, 0, (w - 1) * sizeof(uint64_t));
+    }
+
+    uint64_t any = 0;
+    for (size_t i = 0; i < pattern->words; i++) {
+        any |= set[i];
+    }
+    return any != 0;
+}
+
+// Function to compute the set of items reached from a set by one byte of a class
+static int pattern_step(const CompiledPattern *pattern, const uint64_t *from, size_t byte_class, uint64_t *to) {
+    const uint64_t *mask = pattern->masks + byte_class * pattern->words;
+    uint64_t carry = 0;
+    for (size_t w = 0; w < pattern->words; w++) {
+        uint64_t moved = from[w] & mask[w];
+        to[w] = (moved << 1) | carry | (from[w] & pattern->stars[w]); // A '*' stays where it is
+        carry = moved >> 63;
+    }
+    return pattern_close(pattern, to);
+}
+
+// Function to find a DFA state by its set of items, adding it if it is new
+// Returns the state, or -1 if adding it would pass PATTERN_MAX_STATES
+static int32_t pattern_state(CompiledPattern *pattern, uint64_t **sets, size_t *capacity, int32_t *slots,
+                             const uint64_t *set) {
+    size_t bytes = pattern->words * sizeof(uint64_t);
+    size_t slot = (size_t)hash_view((StringView){(const char *)set, bytes}) & (2 * PATTERN_MAX_STATES - 1);
+    while (slots[slot] >= 0) {
+        if (memcmp(*sets + (size_t)slots[slot] * pattern->words, set, bytes) == 0) return slots[slot];
+        slot = (slot + 1) & (2 * PATTERN_MAX_STATES - 1);
+    }
+    if (pattern->state_count == PATTERN_MAX_STATES) return -1;
+
+    if (pattern->state_count == *capacity) {
+        *capacity *= 2; // Double the capacity
+        *sets = (uint64_t *)realloc(*sets, *capacity * bytes);
+        pattern->next = (int32_t *)realloc(pattern->next, *capacity * pattern->class_count * sizeof(int32_t));
+        pattern->accepting = (unsigned char *)realloc(pattern->accepting, *capacity);
+        pattern->settled = (unsigned char *)realloc(pattern->settled, *capacity);
+        if (!*sets || !pattern->next || !pattern->accepting || !pattern->settled) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    int32_t state = (int32_t)pattern->state_count++;
+    memcpy(*sets + (size_t)state * pattern->words, set, bytes);
+    pattern->accepting[state] = (set[pattern->positions >> 6] >> (pattern->positions & 63)) & 1;
+    slots[slot] = state;
+    return state;
+}
+
+// Function to lower a glob whose items are all '*' or a single byte to the literals between its stars
+// Leaves pattern->literals NULL for any other glob and for one without both a '*' and a literal
+static void pattern_lower_literals(CompiledPattern *pattern, const uint64_t (*items)[4], const unsigned char *is_star,
+                                   size_t count) {
+    pattern->literals = NULL;
+    pattern->literal_count = 0;
+    pattern->anchored_start = 0;
+    pattern->anchored_end = 0;
+
+    size_t stars = 0;
+    for (size_t p = 0; p < count; p++) {
+        if (is_star[p]) {
+            stars++;
+            continue;
+        }
+        int bits = 0;
+        for (int w = 0; w < 4; w++) {
+            bits += __builtin_popcountll(items[p][w]);
+        }
+        if (bits != 1) return; // A '?', a set or a folded letter: the DFA handles it
+    }
+    if (stars == 0 || stars == count) return; // Nothing to chain; the DFA settles these at once
+
+    char *bytes = (char *)malloc(count);
+    pattern->literals = (StringSearcher *)malloc((stars + 1) * sizeof(StringSearcher));
+    if (!bytes || !pattern->literals) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t length = 0;
+    for (size_t p = 0; p <= count; p++) {
+        if (p < count && !is_star[p]) {
+            int w = 0;
+            while (!items[p][w]) w++;
+            bytes[length++] = (char)(64 * w + __builtin_ctzll(items[p][w]));
+        } else if (length) {
+            StringView literal = {bytes, length};
+            pattern->literals[pattern->literal_count++] = create_searcher(literal);
+            length = 0;
+        }
+    }
+    free(bytes);
+    pattern->anchored_start = !is_star[0];
+    pattern->anchored_end = !is_star[count - 1];
+}
+
+// Function to compile a glob: '*' matches any run of bytes, '?' any one byte, [a-z] or [!a-z] one
+// byte of a set, and a backslash makes the next byte literal; everything else matches itself
+// Flags: PATTERN_CASE_INSENSITIVE; the pattern must match the whole input
+CompiledPattern compile_pattern(const char *glob, int flags) {
+    CompiledPattern pattern;
+    size_t glob_len = strlen(glob);
+    uint64_t (*items)[4] = (uint64_t (*)[4])malloc((glob_len ? glob_len : 1) * sizeof(*items));
+    unsigned char *is_star = (unsigned char *)malloc(glob_len ? glob_len : 1);
+    if (!items || !is_star) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Parse the glob into items
+    size_t count = 0, used;
+    for (size_t i = 0; i < glob_len;) {
+        unsigned char byte = (unsigned char)glob[i++];
+        is_star[count] = 0;
+        memset(items[count], 0, sizeof(items[count]));
+        if (byte == '*') {
+            if (count > 0 && is_star[count - 1]) continue; // ** is the same as *
+            is_star[count] = 1;
+        } else if (byte == '?') {
+            memset(items[count], 0xFF, sizeof(items[count]));
+        } else if (byte == '[' && (used = pattern_parse_bracket(glob + i, items[count], flags)) > 0) {
+            i += used;
+        } else {
+            if (byte == '\\' && i < glob_len) byte = (unsigned char)glob[i++];
+            pattern_set_add(items[count], byte, flags);
+        }
+        count++;
+    }
+    pattern.positions = count;
+    pattern.words = count / 64 + 1; // Position count, one past the last item, means a match
+    pattern_lower_literals(&pattern, (const uint64_t (*)[4])items, is_star, count);
+
+    // Group the bytes that every item treats alike into classes
+    unsigned char representative[256];
+    pattern.class_count = 0;
+    for (unsigned byte = 0; byte < 256; byte++) {
+        size_t c = 0;
+        for (; c < pattern.class_count; c++) {
+            unsigned other = representative[c];
+            size_t p = 0;
+            while (p < count && ((items[p][byte >> 6] >> (byte & 63)) & 1) == ((items[p][other >> 6] >> (other & 63)) & 1)) {
+                p++;
+            }
+            if (p == count) break;
+        }
+        if (c == pattern.class_count) representative[pattern.class_count++] = (unsigned char)byte;
+        pattern.byte_class[byte] = (unsigned char)c;
+    }
+
+    pattern.masks = (uint64_t *)calloc(pattern.class_count * pattern.words, sizeof(uint64_t));
+    pattern.stars = (uint64_t *)calloc(pattern.words, sizeof(uint64_t));
+    if (!pattern.masks || !pattern.stars) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t p = 0; p < count; p++) {
+        if (is_star[p]) {
+            pattern.stars[p >> 6] |= 1ULL << (p & 63);
+            continue;
+        }
+        for (size_t c = 0; c < pattern.class_count; c++) {
+            unsigned byte = representative[c];
+            if ((items[p][byte >> 6] >> (byte & 63)) & 1) pattern.masks[c * pattern.words + (p >> 6)] |= 1ULL << (p & 63);
+        }
+    }
+    free(items);
+    free(is_star);
+
+    // Subset construction, visiting the states in the order they are found
+    size_t capacity = 16;
+    uint64_t *sets = (uint64_t *)malloc(capacity * pattern.words * sizeof(uint64_t));
+    uint64_t *set = (uint64_t *)calloc(pattern.words, sizeof(uint64_t));
+    int32_t *slots = (int32_t *)malloc(2 * PATTERN_MAX_STATES * sizeof(int32_t));
+    pattern.next = (int32_t *)malloc(capacity * pattern.class_count * sizeof(int32_t));
+    pattern.accepting = (unsigned char *)malloc(capacity);
+    pattern.settled = (unsigned char *)malloc(capacity);
+    if (!sets || !set || !slots || !pattern.next || !pattern.accepting || !pattern.settled) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(slots, -1, 2 * PATTERN_MAX_STATES * sizeof(int32_t));
+    pattern.state_count = 0;
+    set[0] = 1;
+    pattern_close(&pattern, set);
+    pattern_state(&pattern, &sets, &capacity, slots, set);
+
+    for (size_t state = 0; state < pattern.state_count; state++) {
+        int settled = 1;
+        for (size_t c = 0; c < pattern.class_count; c++) {
+            pattern_step(&pattern, sets + state * pattern.words, c, set);
+            int32_t target = pattern_state(&pattern, &sets, &capacity, slots, set);
+            if (target < 0) {
+                // Too many states: match by stepping the item sets instead
+                free(pattern.next);
+                free(pattern.accepting);
+                free(pattern.settled);
+                pattern.next = NULL;
+                pattern.accepting = NULL;
+                pattern.settled = NULL;
+                pattern.state_count = 0;
+                goto done;
+            }
+            pattern.next[state * pattern.class_count + c] = target;
+            settled &= (size_t)target == state;
+        }
+        pattern.settled[state] = (unsigned char)settled; // Nothing after this can change the verdict
+    }
+
+done:
+    free(sets);
+    free(set);
+    free(slots);
+    return pattern;
+}
+
+// Function to match a glob lowered to literals: each one is searched for after the end of the
+// previous one, since the '*' between them absorbs whatever lies in between
+static int match_literals(const CompiledPattern *pattern, StringView text) {
+    const StringSearcher *literals = pattern->literals;
+    size_t first = 0, last = pattern->literal_count, pos = 0, end = text.len;
+    if (pattern->anchored_start) {
+        if (text.len < literals[0].length || memcmp(text.ptr, literals[0].needle, literals[0].length) != 0) return 0;
+        pos = literals[0].length;
+        first = 1;
+    }
+    if (pattern->anchored_end) {
+        // A '*' separates the two ends, so the last literal is not the one just matched at the start
+        const StringSearcher *suffix = &literals[--last];
+        if (end - pos < suffix->length || memcmp(text.ptr + end - suffix->length, suffix->needle, suffix->length) != 0) {
+            return 0;
+        }
+        end -= suffix->length;
+    }
+
+    StringView window = {text.ptr, end}; // The middle literals must not run into the last one
+    for (size_t i = first; i < last; i++) {
+        size_t at = searcher_find(&literals[i], window, pos);
+        if (at == STRING_NOT_FOUND) return 0;
+        pos = at + literals[i].length;
+    }
+    return 1;
+}
+
+// Function to test whether a compiled pattern matches the whole of a text, in one pass
+int match_pattern(const CompiledPattern *pattern, StringView text) {
+    const unsigned char *bytes = (const unsigned char *)text.ptr;
+    if (pattern->literals) return match_literals(pattern, text);
+    if (pattern->next) {
+        size_t state = 0;
+        for (size_t i = 0; i < text.len && !pattern->settled[state]; i++) {
+            state = (size_t)pattern->next[state * pattern->class_count + pattern->byte_class[bytes[i]]];
+        }
+        return pattern->accepting[state];
+    }
+
+    uint64_t stack_sets[2 * PATTERN_STACK_WORDS] = {0};
+    uint64_t *sets = stack_sets;
+    if (pattern->words > PATTERN_STACK_WORDS) {
+        sets = (uint64_t *)calloc(2 * pattern->words, sizeof(uint64_t));
+        if (!sets) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    uint64_t *current = sets, *following = sets + pattern->words;
+    current[0] = 1;
+    int alive = pattern_close(pattern, current);
+    for (size_t i = 0; i < text.len && alive; i++) {
+        alive = pattern_step(pattern, current, pattern->byte_class[bytes[i]], following);
+        uint64_t *swap = current;
+        current = following;
+        following = swap;
+    }
+    int matched = alive && ((current[pattern->positions >> 6] >> (pattern->positions & 63)) & 1);
+    if (sets != stack_sets) free(sets);
+    return matched;
+}
+
+// Function to match one chunk of a list, a task of string_list_select
+static void select_chunk_task(void *context, size_t chunk) {
+    SelectJob *job = (SelectJob *)context;
+    size_t end = (chunk + 1) * STRING_LIST_CHUNK < job->list->size ? (chunk + 1) * STRING_LIST_CHUNK : job->list->size;
+    for (size_t i = chunk * STRING_LIST_CHUNK; i < end; i++) {
+        job->keep[i] = (unsigned char)match_pattern(job->pattern, string_view(&job->list->strings[i]));
+    }
+}
+
+// Function to copy the entries a compiled pattern matches into a new list, in their order
+// The entries are matched on up to nthreads threads, then copied on the calling thread
+StringList string_list_select(const StringList *list, const CompiledPattern *pattern, size_t nthreads) {
+    STRING_TRACK_START(started);
+    StringList selected = create_string_list();
+    if (list->size == 0) {
+        STRING_TRACK_STOP(started, STRING_OP_LIST_SELECT, 0);
+        return selected;
+    }
+
+    unsigned char *keep = (unsigned char *)tracked_realloc(NULL, 0, list->size);
+    SelectJob job = {list, pattern, keep};
+    run_parallel(nthreads, select_chunk_task, &job, (list->size + STRING_LIST_CHUNK - 1) / STRING_LIST_CHUNK);
+
+    for (size_t i = 0; i < list->size; i++) {
+        if (keep[i]) string_list_push(&selected, copy_string(&list->strings[i]));
+    }
+    tracked_free(keep, list->size);
+    STRING_TRACK_STOP(started, STRING_OP_LIST_SELECT, list->size);
+    return selected;
+}
+
+// Function to free a compiled pattern
+void free_pattern(CompiledPattern *pattern) {
+    free(pattern->next);
+    free(pattern->accepting);
+    free(pattern->settled);
+    free(pattern->masks);
+    free(pattern->stars);
+    for (size_t i = 0; i < pattern->literal_count; i++) {
+        free_searcher(&pattern->literals[i]);
+    }
+    free(pattern->literals);
+    pattern->next = NULL;
+    pattern->accepting = NULL;
+    pattern->settled = NULL;
+    pattern->masks = NULL;
+    pattern->stars = NULL;
+    pattern->literals = NULL;
+    pattern->literal_count = 0;
+    pattern->state_count = 0;
+    pattern->class_count = 0;
+}
+
+
+#ifdef STRING_BENCHMARK
+
+// Function to read a monotonic-enough wall clock in seconds for the benchmarks
+static double benchmark_now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Function to compare malloc-per-string against an arena on a split-heavy workload
+void benchmark_arena_split(void) {
+    const size_t tokens = 1000000, rounds = 10;
+
+    // Build a log-like line of short comma-separated fields
+    size_t length = 0;
+    char *text = (char *)malloc(tokens * 16);
+    if (!text) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < tokens; i++) {
+        length += sprintf(text + length, "%s%zu", i ? "," : "", i * 2654435761u % 100000);
+    }
+    StringView text_view = {text, length};
+    String input = view_to_string(text_view);
+    free(text);
+
+    size_t count = 0;
+    double start = benchmark_now();
+    for (size_t r = 0; r < rounds; r++) {
+        String *parts = split_string(&input, ',', &count);
+        free_string_array(parts, count);
+    }
+    double heap_time = (benchmark_now() - start) / rounds;
+
+    StringArena arena = create_string_arena(1 << 20);
+    start = benchmark_now();
+    for (size_t r = 0; r < rounds; r++) {
+        split_string_in(&arena, &input, ',', &count);
+        arena_reset(&arena);
+    }
+    double arena_time = (benchmark_now() - start) / rounds;
+    arena_free(&arena);
+
+    printf("split %zu tokens (%zu bytes)\n", count, length);
+    printf("  malloc per string: %8.3f ms\n", heap_time * 1e3);
+    printf("  arena:             %8.3f ms (%.2fx)\n", arena_time * 1e3, heap_time / arena_time);
+    free_string(&input);
+}
+
+// Function to join 1M tokens with join_strings and with a strcat loop like the old join_strings
+void benchmark_join(void) {
+    const size_t tokens = 1000000, strcat_tokens = 20000; // The strcat loop is quadratic, so it gets fewer tokens
+
+    String *parts = (String *)malloc(tokens * sizeof(String));
+    if (!parts) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    StringBuilder token = create_string_builder(32);
+    for (size_t i = 0; i < tokens; i++) {
+        builder_append_cstr(&token, "token");
+        builder_append_int(&token, (long long)(i * 2654435761u % 100000));
+        parts[i] = builder_finish(&token);
+    }
+
+    double start = benchmark_now();
+    String joined = join_strings(parts, tokens, ",");
+    double join_time = benchmark_now() - start;
+
+    start = benchmark_now();
+    StringBuilder builder = create_string_builder(0); // No reserve hint, so every doubling is paid for
+    for (size_t i = 0; i < tokens; i++) {
+        if (i > 0) builder_append_char(&builder, ',');
+        builder_append_string(&builder, &parts[i]);
+    }
+    String built = builder_finish(&builder);
+    double builder_time = benchmark_now() - start;
+
+    start = benchmark_now();
+    char *naive = (char *)calloc(joined.length + 1, 1);
+    if (!naive) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < strcat_tokens; i++) {
+        strcat(naive, string_data(&parts[i]));
+        if (i < strcat_tokens - 1) strcat(naive, ",");
+    }
+    double strcat_time = benchmark_now() - start;
+
+    printf("join %zu tokens (%zu bytes)\n", tokens, joined.length);
+    printf("  join_strings:         %8.3f ms\n", join_time * 1e3);
+    printf("  builder, no reserve:  %8.3f ms\n", builder_time * 1e3);
+    printf("  strcat loop, %zu:  %8.3f ms\n", strcat_tokens, strcat_time * 1e3);
+
+    free(naive);
+    free_string(&built);
+    free_string(&joined);
+    for (size_t i = 0; i < tokens; i++) {
+        free_string(&parts[i]);
+    }
+    free(parts);
+}
+
+// Function to adapt compare_strings to qsort for the sorting baseline
+static int benchmark_compare_entries(const void *a, const void *b) {
+    return compare_strings((const String *)a, (const String *)b);
+}
+
+// Function to compare qsort + compare_strings with sort_string_list at 1 to 16 threads
+void benchmark_sort(void) {
+    const size_t keys = 2000000;
+
+    // Random keys of 4 to 40 lowercase letters sharing a few common prefixes
+    static const char *prefixes[] = {"", "user:", "session:", "user:profile:"};
+    StringList list = create_string_list();
+    StringBuilder key = create_string_builder(64);
+    uint64_t seed = 88172645463325252ULL;
+    for (size_t i = 0; i < keys; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        builder_append_cstr(&key, prefixes[seed % 4]);
+        for (size_t j = 0, n = 4 + (seed >> 8) % 37; j < n; j++) {
+            builder_append_char(&key, (char)('a' + (seed >> (j % 50)) % 26));
+        }
+        String str = builder_finish(&key);
+        add_string_to_list(&list, &str);
+        free_string(&str);
+    }
+
+    // Every run sorts a shallow copy of the entries, which all borrow the original Strings
+    StringList copy = list;
+    copy.strings = (String *)malloc(list.capacity * sizeof(String));
+    if (!copy.strings) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("sort %zu keys\n", keys);
+    memcpy(copy.strings, list.strings, keys * sizeof(String));
+    double start = benchmark_now();
+    qsort(copy.strings, copy.size, sizeof(String), benchmark_compare_entries);
+    double qsort_time = benchmark_now() - start;
+    printf("  qsort + compare_strings: %8.3f ms\n", qsort_time * 1e3);
+
+    for (size_t nthreads = 1; nthreads <= 16; nthreads *= 2) {
+        memcpy(copy.strings, list.strings, keys * sizeof(String));
+        start = benchmark_now();
+        sort_string_list(&copy, nthreads);
+        double sort_time = benchmark_now() - start;
+        printf("  sort_string_list, %2zu threads: %8.3f ms (%.2fx)\n", nthreads, sort_time * 1e3, qsort_time / sort_time);
+    }
+
+    free(copy.strings);
+    free_string_list(&list);
+}
+
+// Function to keep entries containing "error", the filter the list benchmark applies
+static int benchmark_is_error(const String *str) {
+    return find_view(string_view(str), cstr_view("error")) != STRING_NOT_FOUND;
+}
+
+// Function to time string_list_map(trim_string, to_lower_case) and string_list_filter at 1 to 16 threads
+void benchmark_list_map(void) {
+    const size_t entries = 2000000;
+
+    StringList list = create_string_list();
+    StringBuilder line = create_string_builder(64);
+    for (size_t i = 0; i < entries; i++) {
+        builder_append_cstr(&line, "  2024-05-01 Service ");
+        builder_append_cstr(&line, i % 7 == 0 ? "ERROR request " : "INFO request ");
+        builder_append_int(&line, (long long)(i * 2654435761u % 1000000));
+        builder_append_cstr(&line, "  ");
+        String str = builder_finish(&line);
+        add_string_to_list(&list, &str);
+        free_string(&str);
+    }
+
+    printf("map/filter %zu entries\n", entries);
+    for (size_t nthreads = 1; nthreads <= 16; nthreads *= 2) {
+        StringList copy = create_string_list();
+        for (size_t i = 0; i < list.size; i++) {
+            add_string_to_list(&copy, &list.strings[i]);
+        }
+
+        double start = benchmark_now();
+        string_list_map(&copy, trim_string, nthreads);
+        string_list_map(&copy, to_lower_case, nthreads);
+        double map_time = benchmark_now() - start;
+
+        start = benchmark_now();
+        string_list_filter(&copy, benchmark_is_error, nthreads);
+        double filter_time = benchmark_now() - start;
+
+        printf("  %2zu threads: map %8.3f ms, filter %8.3f ms (%zu kept)\n", nthreads, map_time * 1e3, filter_time * 1e3, copy.size);
+        free_string_list(&copy);
+    }
+    free_string_list(&list);
+}
+
+// Function to time find_all_substrings against parallel_find_all and parallel_count at 1 to 16 threads
+void benchmark_parallel_find(void) {
+    const size_t length = (size_t)256 << 20;
+
+    // A dump-like haystack with a needle roughly every 4 KB
+    char *text = (char *)malloc(length + 1);
+    if (!text) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    uint64_t seed = 42;
+    for (size_t i = 0; i < length; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        text[i] = (char)('a' + seed % 26);
+        if (seed % 4096 == 0 && i + 9 <= length) {
+            memcpy(text + i, "ERROR:503", 9);
+            i += 8;
+        }
+    }
+    StringView text_view = {text, length};
+    String dump = view_to_string(text_view);
+    free(text);
+    StringView needle = cstr_view("ERROR:503");
+
+    size_t count = 0;
+    double start = benchmark_now();
+    size_t *matches = find_all_substrings(&dump, needle, &count);
+    double serial_time = benchmark_now() - start;
+    free_match_offsets(matches, count);
+
+    printf("find all in %zu MB (%zu matches)\n", length >> 20, count);
+    printf("  find_all_substrings:       %8.3f ms\n", serial_time * 1e3);
+    for (size_t nthreads = 1; nthreads <= 16; nthreads *= 2) {
+        start = benchmark_now();
+        matches = parallel_find_all(&dump, needle, nthreads, &count);
+        double find_time = benchmark_now() - start;
+        free_match_offsets(matches, count);
+
+        start = benchmark_now();
+        count = parallel_count(&dump, needle, nthreads);
+        double count_time = benchmark_now() - start;
+        printf("  %2zu threads: parallel_find_all %8.3f ms (%.2fx), parallel_count %8.3f ms\n", nthreads,
+               find_time * 1e3, serial_time / find_time, count_time * 1e3);
+    }
+    free_string(&dump);
+}
+
+// Function to time building 1M formatted records with snprintf, builder_appendf and the printf-free appenders
+void benchmark_format(void) {
+    const size_t records = 1000000;
+    char record[128];
+
+    double start = benchmark_now();
+    StringBuilder out = create_string_builder(0);
+    for (size_t i = 0; i < records; i++) {
+        int written = snprintf(record, sizeof(record), "id=%zu qty=%d price=%.2f\n", i, (int)(i % 1000), (double)(i % 100000) / 100);
+        StringView view = {record, (size_t)written};
+        builder_append_view(&out, view);
+    }
+    String snprintf_result = builder_finish(&out);
+    double snprintf_time = benchmark_now() - start;
+
+    start = benchmark_now();
+    out = create_string_builder(0);
+    for (size_t i = 0; i < records; i++) {
+        builder_appendf(&out, "id=%zu qty=%d price=%.2f\n", i, (int)(i % 1000), (double)(i % 100000) / 100);
+    }
+    String appendf_result = builder_finish(&out);
+    double appendf_time = benchmark_now() - start;
+
+    start = benchmark_now();
+    out = create_string_builder(0);
+    for (size_t i = 0; i < records; i++) {
+        builder_append_cstr(&out, "id=");
+        builder_append_uint(&out, i);
+        builder_append_cstr(&out, " qty=");
+        builder_append_int(&out, (long long)(i % 1000));
+        builder_append_cstr(&out, " price=");
+        builder_append_fixed(&out, (long long)(i % 100000), 2);
+        builder_append_char(&out, '\n');
+    }
+    String fast_result = builder_finish(&out);
+    double fast_time = benchmark_now() - start;
+
+    printf("format %zu records (%zu bytes, outputs %s)\n", records, fast_result.length,
+           views_equal(string_view(&snprintf_result), string_view(&fast_result)) &&
+           views_equal(string_view(&appendf_result), string_view(&fast_result)) ? "match" : "DIFFER");
+    printf("  snprintf + copy:    %8.3f ms\n", snprintf_time * 1e3);
+    printf("  builder_appendf:    %8.3f ms (%.2fx)\n", appendf_time * 1e3, snprintf_time / appendf_time);
+    printf("  integer appenders:  %8.3f ms (%.2fx)\n", fast_time * 1e3, snprintf_time / fast_time);
+    free_string(&fast_result);
+    free_string(&appendf_result);
+    free_string(&snprintf_result);
+}
+
+// Function to time converting 1M-entry integer and decimal columns with strtoll/strtod and parse_column
+void benchmark_parse(void) {
+    const size_t entries = 1000000;
+
+    // Columns as they come out of a CSV: ids, signed quantities and prices of varying width
+    StringList integers = create_string_list();
+    StringList decimals = create_string_list();
+    StringBuilder field = create_string_builder(32);
+    for (size_t i = 0; i < entries; i++) {
+        uint64_t mixed = (uint64_t)i * 0x9E3779B97F4A7C15ULL;
+        if (i % 3 == 0) builder_append_char(&field, '-');
+        builder_append_uint(&field, mixed >> (mixed % 48 + 16));
+        String str = builder_finish(&field);
+        add_string_to_list(&integers, &str);
+        free_string(&str);
+
+        builder_append_fixed(&field, (long long)(mixed % 100000000) - 50000000, (unsigned)(i % 7));
+        str = builder_finish(&field);
+        add_string_to_list(&decimals, &str);
+        free_string(&str);
+    }
+
+    int64_t *libc_integers = (int64_t *)malloc(entries * sizeof(int64_t));
+    int64_t *parsed_integers = (int64_t *)malloc(entries * sizeof(int64_t));
+    double *libc_decimals = (double *)malloc(entries * sizeof(double));
+    double *parsed_decimals = (double *)malloc(entries * sizeof(double));
+    if (!libc_integers || !parsed_integers || !libc_decimals || !parsed_decimals) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    double start = benchmark_now();
+    for (size_t i = 0; i < entries; i++) {
+        libc_integers[i] = strtoll(string_data(&integers.strings[i]), NULL, 10);
+    }
+    double strtoll_time = benchmark_now() - start;
+
+    start = benchmark_now();
+    ParseStatus integer_status = parse_column(&integers, PARSE_I64, parsed_integers, NULL);
+    double parse_i64_time = benchmark_now() - start;
+
+    start = benchmark_now();
+    for (size_t i = 0; i < entries; i++) {
+        libc_decimals[i] = strtod(string_data(&decimals.strings[i]), NULL);
+    }
+    double strtod_time = benchmark_now() - start;
+
+    start = benchmark_now();
+    ParseStatus decimal_status = parse_column(&decimals, PARSE_DOUBLE, parsed_decimals, NULL);
+    double parse_double_time = benchmark_now() - start;
+
+    printf("parse %zu-entry columns (results %s)\n", entries,
+           integer_status == PARSE_OK && decimal_status == PARSE_OK &&
+           !memcmp(libc_integers, parsed_integers, entries * sizeof(int64_t)) &&
+           !memcmp(libc_decimals, parsed_decimals, entries * sizeof(double)) ? "match" : "DIFFER");
+    printf("  strtoll:                 %8.3f ms\n", strtoll_time * 1e3);
+    printf("  parse_column(I64):       %8.3f ms (%.2fx)\n", parse_i64_time * 1e3, strtoll_time / parse_i64_time);
+    printf("  strtod:                  %8.3f ms\n", strtod_time * 1e3);
+    printf("  parse_column(DOUBLE):    %8.3f ms (%.2fx)\n", parse_double_time * 1e3, strtod_time / parse_double_time);
+    free(parsed_decimals);
+    free(libc_decimals);
+    free(parsed_integers);
+    free(libc_integers);
+    free_string_list(&decimals);
+    free_string_list(&integers);
+}
+
+// Function to time UTF-8 validation and counting against the scalar loops on ASCII and mixed text
+void benchmark_utf8(void) {
+    const size_t length = (size_t)64 << 20;
+    static const char *const samples[] = {"plain ascii words ", "caf\xC3\xA9 ", "\xD0\xBC\xD0\xB8\xD1\x80 ",
+                                          "\xE6\x9D\xB1\xE4\xBA\xAC ", "\xF0\x9F\x98\x80 "};
+
+    char *text = (char *)malloc(length);
+    if (!text) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int mixed = 0; mixed <= 1; mixed++) {
+        size_t used = 0;
+        for (size_t i = 0;; i++) {
+            const char *sample = samples[mixed ? i % 5 : 0];
+            size_t sample_length = strlen(sample);
+            if (used + sample_length > length) break;
+            memcpy(text + used, sample, sample_length);
+            used += sample_length;
+        }
+        StringView view = {text, used};
+
+        double start = benchmark_now();
+        size_t scalar_error = utf8_validate_scalar((const unsigned char *)text, used, 0);
+        double scalar_time = benchmark_now() - start;
+
+        start = benchmark_now();
+        int valid = utf8_validate(view, NULL);
+        double validate_time = benchmark_now() - start;
+
+        start = benchmark_now();
+        size_t scalar_count = 0;
+        for (size_t i = 0; i < used; i++) {
+            scalar_count += ((unsigned char)text[i] & 0xC0) != 0x80;
+        }
+        double scalar_count_time = benchmark_now() - start;
+
+        start = benchmark_now();
+        size_t count = utf8_count(view);
+        double count_time = benchmark_now() - start;
+
+        printf("utf-8 over %zu MB of %s text (%s)\n", used >> 20, mixed ? "mixed-script" : "ASCII",
+               valid && scalar_error == STRING_NOT_FOUND && count == scalar_count ? "results match" : "results DIFFER");
+        printf("  validate scalar:   %8.3f ms (%.2f GB/s)\n", scalar_time * 1e3, (double)used / scalar_time / 1e9);
+        printf("  utf8_validate:     %8.3f ms (%.2f GB/s)\n", validate_time * 1e3, (double)used / validate_time / 1e9);
+        printf("  count scalar:      %8.3f ms (%.2f GB/s)\n", scalar_count_time * 1e3, (double)used / scalar_count_time / 1e9);
+        printf("  utf8_count:        %8.3f ms (%.2f GB/s)\n", count_time * 1e3, (double)used / count_time / 1e9);
+    }
+    free(text);
+}
+
+// Function to time fanning one 1 KB payload out into 4 lists of 25000 entries, copied and shared
+void benchmark_shared(void) {
+    const size_t lists = 4;
+    const size_t entries = 25000;
+
+    char text[1024];
+    memset(text, 'x', sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+
+    for (int shared = 0; shared <= 1; shared++) {
+        String payload = create_string(text);
+        if (shared) share_string(&payload);
+
+        reset_performance();
+        double start = benchmark_now();
+        StringList fan_out[4];
+        for (size_t l = 0; l < lists; l++) {
+            fan_out[l] = create_string_list();
+            for (size_t i = 0; i < entries; i++) {
+                add_string_to_list(&fan_out[l], &payload);
+            }
+        }
+        double fill_time = benchmark_now() - start;
+        PerformanceTracker stats = snapshot_performance();
+
+        start = benchmark_now();
+        for (size_t l = 0; l < lists; l++) {
+            free_string_list(&fan_out[l]);
+        }
+        double free_time = benchmark_now() - start;
+
+        printf("fan-out %s: %zu inserts %8.3f ms, free %8.3f ms, peak %zu KB\n", shared ? "shared" : "copied",
+               lists * entries, fill_time * 1e3, free_time * 1e3, stats.peak_bytes >> 10);
+        free_string(&payload);
+    }
+}
+
+// Function to time rebuilding a 2M-entry list by splitting text against reopening a saved snapshot
+void benchmark_snapshot(void) {
+    const size_t entries = 2000000;
+    const char *path = "string_benchmark_snapshot.bin";
+
+    // A dictionary-like text: one word per line
+    StringBuilder text_builder = create_string_builder(entries * 12);
+    for (size_t i = 0; i < entries; i++) {
+        builder_append_cstr(&text_builder, i % 3 ? "word-" : "allow-list-entry-");
+        builder_append_uint(&text_builder, (i * 2654435761u) % 100000000);
+        builder_append_char(&text_builder, '\n');
+    }
+    String text = builder_finish(&text_builder);
+
+    double start = benchmark_now();
+    size_t count;
+    String *words = split_string(&text, '\n', &count);
+    StringList rebuilt = create_string_list();
+    for (size_t i = 0; i < count; i++) {
+        string_list_push(&rebuilt, words[i]); // The list takes the split results over without copying
+    }
+    tracked_free(words, count * sizeof(String)); // Only the array is left to free
+    double rebuild_time = benchmark_now() - start;
+
+    start = benchmark_now();
+    int saved = save_string_list(&rebuilt, path);
+    double save_time = benchmark_now() - start;
+
+    start = benchmark_now();
+    MappedStringList mapped = open_string_list_mmap(path);
+    double open_time = benchmark_now() - start;
+
+    start = benchmark_now();
+    StringList borrowed = mapped_string_list_to_string_list(&mapped);
+    double borrow_time = benchmark_now() - start;
+
+    start = benchmark_now();
+    int intact = verify_mapped_string_list(&mapped);
+    double verify_time = benchmark_now() - start;
+
+    int same = saved == 0 && intact && borrowed.size == rebuilt.size;
+    for (size_t i = 0; same && i < rebuilt.size; i++) {
+        same = views_equal(string_view(&borrowed.strings[i]), string_view(&rebuilt.strings[i]));
+    }
+    printf("snapshot of %zu entries (%s)\n", rebuilt.size, same ? "lists match" : "lists DIFFER");
+    printf("  split and build:   %8.3f ms\n", rebuild_time * 1e3);
+    printf("  save:              %8.3f ms\n", save_time * 1e3);
+    printf("  open (mmap):       %8.3f ms\n", open_time * 1e3);
+    printf("  as StringList:     %8.3f ms\n", borrow_time * 1e3);
+    printf("  verify checksum:   %8.3f ms\n", verify_time * 1e3);
+
+    free_string_list(&borrowed);
+    free_mapped_string_list(&mapped);
+    remove(path);
+    free_string_list(&rebuilt);
+    free_string(&text);
+}
+
+// Function to compute an unbounded edit distance with the textbook two-row DP, the baseline for benchmark_fuzzy
+static size_t benchmark_levenshtein(StringView a, StringView b, size_t *row) {
+    for (size_t j = 0; j <= b.len; j++) {
+        row[j] = j;
+    }
+    for (size_t i = 1; i <= a.len; i++) {
+        size_t diagonal = row[0];
+        row[0] = i;
+        for (size_t j = 1; j <= b.len; j++) {
+            size_t above = row[j];
+            size_t best = diagonal + (a.ptr[i - 1] != b.ptr[j - 1]);
+            if (above + 1 < best) best = above + 1;
+            if (row[j - 1] + 1 < best) best = row[j - 1] + 1;
+            row[j] = best;
+            diagonal = above;
+        }
+    }
+    return row[b.len];
+}
+
+// Function to time a typo-tolerant lookup in 1M names with the plain DP against fuzzy_find at 1 to 4 threads
+void benchmark_fuzzy(void) {
+    const size_t entries = 1000000;
+    const size_t k = 2;
+    static const char *const first[] = {"anna", "bernard", "carla", "dmitri", "elena", "farid", "grace", "hiroshi"};
+    static const char *const last[] = {"andersen", "baker", "castillo", "dubois", "eriksson", "fischer", "gupta", "horvath"};
+
+    StringList names = create_string_list();
+    uint64_t seed = 7;
+    for (size_t i = 0; i < entries; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        StringBuilder builder = create_string_builder(32);
+        builder_append_cstr(&builder, first[seed % 8]);
+        builder_append_char(&builder, ' ');
+        builder_append_cstr(&builder, last[(seed >> 3) % 8]);
+        builder_append_uint(&builder, (seed >> 6) % 1000);
+        string_list_push(&names, builder_finish(&builder));
+    }
+    StringView query = cstr_view("elena fisher42");
+
+    size_t *row = (size_t *)malloc(64 * sizeof(size_t));
+    if (!row) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t expected = 0;
+    double start = benchmark_now();
+    for (size_t i = 0; i < names.size; i++) {
+        StringView name = string_view(&names.strings[i]);
+        if (name.len < 64 && benchmark_levenshtein(query, name, row) <= k) expected++;
+    }
+    double naive_time = benchmark_now() - start;
+    free(row);
+
+    printf("fuzzy find within %zu edits in %zu names (%zu matches)\n", k, names.size, expected);
+    printf("  plain DP:              %8.3f ms\n", naive_time * 1e3);
+    for (size_t nthreads = 1; nthreads <= 4; nthreads *= 2) {
+        size_t count;
+        start = benchmark_now();
+        FuzzyMatch *matches = fuzzy_find(&names, query, k, nthreads, &count);
+        double fuzzy_time = benchmark_now() - start;
+        printf("  %2zu threads: fuzzy_find %8.3f ms (%.2fx)%s\n", nthreads, fuzzy_time * 1e3, naive_time / fuzzy_time,
+               count == expected ? "" : " (counts DIFFER)");
+        free(matches);
+    }
+    free_string_list(&names);
+}
+
+// Function to time filtering 1M log lines with chained find_view calls against a compiled glob and string_list_select
+void benchmark_pattern(void) {
+    const size_t entries = 1000000;
+    static const char *const levels[] = {"INFO", "WARN", "error", "debug"};
+    static const char *const events[] = {"request served", "upstream timeout", "cache miss", "retrying"};
+
+    StringList lines = create_string_list();
+    uint64_t seed = 11;
+    for (size_t i = 0; i < entries; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        StringBuilder builder = create_string_builder(64);
+        builder_append_cstr(&builder, "svc-");
+        builder_append_uint(&builder, 10 + seed % 90);
+        builder_append_cstr(&builder, "-api ");
+        builder_append_cstr(&builder, levels[(seed >> 8) % 4]);
+        builder_append_cstr(&builder, " shard ");
+        builder_append_uint(&builder, (seed >> 12) % 1000);
+        builder_append_char(&builder, ' ');
+        builder_append_cstr(&builder, events[(seed >> 24) % 4]);
+        string_list_push(&lines, builder_finish(&builder));
+    }
+
+    // *error*timeout* by hand: find the first word, then the second after it
+    StringView first = cstr_view("error"), second = cstr_view("timeout");
+    size_t expected = 0;
+    double start = benchmark_now();
+    for (size_t i = 0; i < lines.size; i++) {
+        StringView line = string_view(&lines.strings[i]);
+        size_t at = find_view(line, first);
+        if (at != STRING_NOT_FOUND && find_view(substring_view(line, at + first.len, line.len), second) != STRING_NOT_FOUND) {
+            expected++;
+        }
+    }
+    double chained_time = benchmark_now() - start;
+
+    start = benchmark_now();
+    CompiledPattern pattern = compile_pattern("*error*timeout*", 0);
+    double compile_time = benchmark_now() - start;
+
+    size_t count = 0;
+    start = benchmark_now();
+    for (size_t i = 0; i < lines.size; i++) {
+        count += (size_t)match_pattern(&pattern, string_view(&lines.strings[i]));
+    }
+    double match_time = benchmark_now() - start;
+
+    // Parsing the glob again for every line, on a sample
+    const size_t sample = 10000;
+    start = benchmark_now();
+    for (size_t i = 0; i < sample; i++) {
+        CompiledPattern once = compile_pattern("*error*timeout*", 0);
+        match_pattern(&once, string_view(&lines.strings[i]));
+        free_pattern(&once);
+    }
+    double per_call_time = (benchmark_now() - start) * (double)lines.size / (double)sample;
+
+    CompiledPattern folded = compile_pattern("*ERROR*TIMEOUT*", PATTERN_CASE_INSENSITIVE);
+    size_t folded_count = 0;
+    start = benchmark_now();
+    for (size_t i = 0; i < lines.size; i++) {
+        folded_count += (size_t)match_pattern(&folded, string_view(&lines.strings[i]));
+    }
+    double folded_time = benchmark_now() - start;
+
+    printf("glob *error*timeout* over %zu lines (%zu matches%s)\n", lines.size, expected,
+           count == expected && folded_count == expected ? "" : ", counts DIFFER");
+    printf("  chained find_view:    %8.3f ms\n", chained_time * 1e3);
+    printf("  compile_pattern:      %8.3f ms (%zu states, %zu byte classes)\n", compile_time * 1e3, pattern.state_count,
+           pattern.class_count);
+    printf("  match_pattern:        %8.3f ms (%.2fx)\n", match_time * 1e3, chained_time / match_time);
+    printf("  compile every call:   %8.3f ms (estimated from %zu lines)\n", per_call_time * 1e3, sample);
+    printf("  case-insensitive:     %8.3f ms\n", folded_time * 1e3);
+    for (size_t nthreads = 1; nthreads <= 4; nthreads *= 2) {
+        start = benchmark_now();
+        StringList selected = string_list_select(&lines, &pattern, nthreads);
+        double select_time = benchmark_now() - start;
+        printf("  %2zu threads: string_list_select %8.3f ms (%zu kept)\n", nthreads, select_time * 1e3, selected.size);
+        free_string_list(&selected);
+    }
+    free_pattern(&pattern);
+    free_pattern(&folded);
+    free_string_list(&lines);
+}
+
+// Function to check that replace_many prefers the leftmost, then longest, match over one that ends first
+void check_replace_many(void) {
+    static const struct {
+        const char *input, *expected;
+        ReplacePair pairs[2];
+    } cases[] = {
+        {"password=hunter2; token=abcd", "[REDACTED]; token=abcd",
+         {{{"password=hunter2", 16}, {"[REDACTED]", 10}}, {{"word", 4}, {"WORD", 4}}}},
+        {"xabcdx", "x[ABCD]x", {{{"abcd", 4}, {"[ABCD]", 6}}, {{"bc", 2}, {"[B]", 3}}}},
+    };
+    size_t failed = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        String input = create_string(cases[i].input);
+        String result = replace_many(&input, cases[i].pairs, 2);
+        if (strcmp(string_data(&result), cases[i].expected) != 0) {
+            printf("  replace_many(\"%s\") gave \"%s\", expected \"%s\"\n", cases[i].input, string_data(&result),
+                   cases[i].expected);
+            failed++;
+        }
+        free_string(&result);
+        free_string(&input);
+    }
+    printf("check replace_many leftmost-longest: %s\n", failed ? "FAILED" : "ok");
+}
+
+// Function to validate UTF-8 by decoding every sequence, independently of the table kernels
+// Returns the offset of the first invalid or truncated sequence, or STRING_NOT_FOUND
+static size_t check_utf8_reference(const unsigned char *data, size_t length) {
+    for (size_t i = 0; i < length;) {
+        unsigned lead = data[i];
+        size_t extra;
+        uint32_t code_point, smallest;
+        if (lead < 0x80) {
+            i++;
+            continue;
+        } else if ((lead & 0xE0) == 0xC0) {
+            extra = 1, code_point = lead & 0x1F, smallest = 0x80;
+        } else if ((lead & 0xF0) == 0xE0) {
+            extra = 2, code_point = lead & 0x0F, smallest = 0x800;
+        } else if ((lead & 0xF8) == 0xF0) {
+            extra = 3, code_point = lead & 0x07, smallest = 0x10000;
+        } else {
+            return i;
+        }
+        for (size_t j = 1; j <= extra; j++) {
+            if (i + j >= length || !utf8_is_continuation(data[i + j])) return i;
+            code_point = (code_point << 6) | (data[i + j] & 0x3F);
+        }
+        if (code_point < smallest || code_point > 0x10FFFF || (code_point >= 0xD800 && code_point <= 0xDFFF)) return i;
+        i += extra + 1;
+    }
+    return STRING_NOT_FOUND;
+}
+
+// Function to fill up to capacity bytes with random code points of every length, optionally corrupting a few bytes
+// Returns the number of bytes written
+static size_t check_utf8_random_text(unsigned char *text, size_t capacity, int corrupt) {
+    static const unsigned char damage[] = {0x80, 0xBF, 0xC0, 0xC1, 0xE0, 0xED, 0xF0, 0xF4, 0xF5, 0xFF, 0x41, 0xA0, 0x90, 0x8F};
+    size_t used = 0;
+    for (;;) {
+        uint32_t kind = (uint32_t)rand() % 10, code_point;
+        if (kind < 5) {
+            code_point = (uint32_t)rand() % 0x80;
+        } else if (kind < 7) {
+            code_point = 0x80 + (uint32_t)rand() % (0x800 - 0x80);
+        } else if (kind < 9) {
+            do code_point = 0x800 + (uint32_t)rand() % (0x10000 - 0x800); while (code_point >= 0xD800 && code_point <= 0xDFFF);
+        } else {
+            code_point = 0x10000 + (uint32_t)rand() % (0x110000 - 0x10000);
+        }
+        size_t units = code_point < 0x80 ? 1 : code_point < 0x800 ? 2 : code_point < 0x10000 ? 3 : 4;
+        if (used + units > capacity) break;
+        if (units == 1) {
+            text[used] = (unsigned char)code_point;
+        } else {
+            text[used] = (unsigned char)((0xF00 >> units) | (code_point >> (6 * (units - 1)))); // 110, 1110 or 11110 prefix
+            for (size_t j = 1; j < units; j++) text[used + j] = (unsigned char)(0x80 | ((code_point >> (6 * (units - 1 - j))) & 0x3F));
+        }
+        used += units;
+    }
+    if (corrupt && used > 0) {
+        for (int hits = 1 + rand() % 3; hits > 0; hits--) {
+            size_t at = (size_t)rand() % used;
+            text[at] = rand() % 2 ? damage[(size_t)rand() % sizeof(damage)] : (unsigned char)rand();
+        }
+        if (rand() % 4 == 0) used--; // Maybe cut the last sequence short
+    }
+    return used;
+}
+
+// Function to compare every UTF-8 validator and counter on one input with the reference decoder and a plain loop
+// Returns the number of results that disagree
+static size_t check_utf8_input(const unsigned char *data, size_t length) {
+    StringView view = {(const char *)data, length};
+    size_t expected = check_utf8_reference(data, length);
+    size_t failed = 0;
+
+    size_t error = STRING_NOT_FOUND;
+    int valid = utf8_validate(view, &error);
+    failed += valid != (expected == STRING_NOT_FOUND) || (!valid && error != expected);
+    failed += utf8_validate_scalar(data, length, 0) != expected;
+#ifdef STRING_HAVE_X86_SIMD
+    // Each kernel, resumed by the scalar pass like utf8_validate does, whatever the CPU would dispatch to
+    if (__builtin_cpu_supports("ssse3")) {
+        failed += utf8_validate_scalar(data, length, utf8_sequence_start(data, utf8_validate_ssse3(data, length))) != expected;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        failed += utf8_validate_scalar(data, length, utf8_sequence_start(data, utf8_validate_avx2(data, length))) != expected;
+    }
+#endif
+
+    size_t code_points = 0;
+    int ascii = 1;
+    for (size_t i = 0; i < length; i++) {
+        code_points += !utf8_is_continuation(data[i]);
+        if (data[i] & 0x80) ascii = 0;
+    }
+    failed += utf8_count(view) != code_points;
+    failed += is_ascii(view) != ascii;
+#ifdef STRING_HAVE_X86_SIMD
+    size_t done;
+    if (__builtin_cpu_supports("sse2")) {
+        size_t count = utf8_count_sse2(data, length, &done);
+        for (; done < length; done++) count += !utf8_is_continuation(data[done]);
+        failed += count != code_points;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        size_t count = utf8_count_avx2(data, length, &done);
+        for (; done < length; done++) count += !utf8_is_continuation(data[done]);
+        failed += count != code_points;
+    }
+#endif
+
+    // A substring of random code points must be the bytes between their offsets
+    String str = view_to_string(view);
+    size_t start = (size_t)rand() % (code_points + 2), count = (size_t)rand() % (code_points + 2);
+    size_t first = length, last = length, index = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (utf8_is_continuation(data[i])) continue;
+        if (index == start) first = i;
+        if (index == start + count) last = i;
+        index++;
+    }
+    if (last < first) last = first;
+    String sub = utf8_substring(&str, start, count);
+    failed += sub.length != last - first || (sub.length && memcmp(string_data(&sub), data + first, sub.length) != 0);
+    free_string(&sub);
+    free_string(&str);
+    return failed;
+}
+
+// Function to check the UTF-8 kernels against a reference decoder on 400k random valid and corrupted inputs
+// and on every 4-byte combination of edge bytes placed across the 16- and 32-byte block seams
+void check_utf8(void) {
+    static const unsigned char edges[] = {0x00, 0x7F, 0x80, 0x8F, 0x90, 0xBF, 0xC0, 0xC2, 0xDF, 0xE0,
+                                          0xED, 0xEF, 0xF0, 0xF4, 0xF5, 0xFF};
+    const size_t edge_count = sizeof(edges);
+    unsigned char text[600];
+    size_t failed = 0;
+
+    srand(21);
+    for (int i = 0; i < 400000; i++) {
+        size_t length = check_utf8_random_text(text, (size_t)rand() % (i % 10 == 0 ? 600 : 100), i % 2);
+        if (i % 7 == 0) memset(text, 'a', (size_t)rand() % (length + 1)); // An ASCII run before the rest
+        failed += check_utf8_input(text, length);
+    }
+    for (size_t combination = 0; combination < edge_count * edge_count * edge_count * edge_count; combination++) {
+        static const size_t seams[] = {0, 13, 29, 30};
+        for (size_t s = 0; s < sizeof(seams) / sizeof(seams[0]); s++) {
+            memset(text, 'a', 40);
+            for (size_t j = 0, c = combination; j < 4; j++, c /= edge_count) text[seams[s] + j] = edges[c % edge_count];
+            failed += check_utf8_input(text, 40);
+        }
+    }
+    printf("check utf8 kernels against a reference decoder: %s\n", failed ? "FAILED" : "ok");
+}
+
+// Define a struct to represent a check_shared_threads job
+typedef struct {
+    const String *payload; // Shared; every task copies it and none may write through it
+    size_t *failed;        // Each task's number of wrong entries
+} SharedCheckJob;
+
+// Function to fan a shared payload out into a list, detach every 7th copy in place and check every entry
+static void shared_check_task(void *context, size_t index) {
+    SharedCheckJob *job = (SharedCheckJob *)context;
+    char first = string_data(job->payload)[0];
+    StringList list = create_string_list();
+    for (size_t i = 0; i < 2000; i++) {
+        add_string_to_list(&list, job->payload);
+    }
+    for (size_t i = 0; i < list.size; i += 7) {
+        if (index % 2) {
+            to_upper_case_inplace(&list.strings[i]);
+        } else {
+            pad_right_inplace(&list.strings[i], list.strings[i].length + 3, '!');
+        }
+    }
+    size_t failed = 0;
+    for (size_t i = 0; i < list.size; i++) {
+        const String *entry = &list.strings[i];
+        const char *data = string_data(entry);
+        if (i % 7 != 0) {
+            failed += data != string_data(job->payload); // Untouched copies still share the buffer
+        } else if (index % 2) {
+            failed += data[0] != (char)toupper((unsigned char)first);
+        } else {
+            failed += entry->length != job->payload->length + 3 || memcmp(data + job->payload->length, "!!!", 3) != 0;
+        }
+    }
+    free_string_list(&list);
+    job->failed[index] = failed;
+}
+
+// Function to check the copy-on-write contract of shared Strings with 8 tasks copying, writing and freeing at once
+// Run it under -fsanitize=thread to check the reference counting as well as the results
+void check_shared_threads(void) {
+    const size_t tasks = 8;
+    char text[200];
+    memset(text, 'p', sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+    String payload = create_string(text);
+    share_string(&payload);
+
+    size_t failed[8] = {0};
+    SharedCheckJob job = {&payload, failed};
+    run_parallel(tasks, shared_check_task, &job, tasks);
+
+    size_t total = 0;
+    for (size_t i = 0; i < tasks; i++) {
+        total += failed[i];
+    }
+    total += strcmp(string_data(&payload), text) != 0; // No task wrote through the shared buffer
+    total += string_ref_count(&payload) != 1;          // Every copy gave its reference back
+    free_string(&payload);
+    printf("check shared Strings across threads: %s\n", total ? "FAILED" : "ok");
+}
+
+// Function to split text at every delimiter the way the tokenizer should, scanning naively
+// Stores at most capacity tokens and returns how many there are
+static size_t check_tokenizer_reference(StringView text, StringView delimiter, int flags, StringView *tokens, size_t capacity) {
+    size_t count = 0, start = 0, i = 0;
+    while (i <= text.len) {
+        size_t skip = 0;
+        if (i == text.len) {
+            skip = 1; // The end of the input closes the last token
+        } else if (flags & TOKENIZER_DELIMITER_SET) {
+            skip = memchr(delimiter.ptr, text.ptr[i], delimiter.len) != NULL;
+        } else if (i + delimiter.len <= text.len && memcmp(text.ptr + i, delimiter.ptr, delimiter.len) == 0) {
+            skip = delimiter.len;
+        }
+        if (!skip) {
+            i++;
+            continue;
+        }
+        if ((i > start || !(flags & TOKENIZER_SKIP_EMPTY)) && count < capacity) {
+            tokens[count].ptr = text.ptr + start;
+            tokens[count].len = i - start;
+            count++;
+        }
+        i += skip;
+        start = i;
+    }
+    return count;
+}
+
+// Function to check the streaming tokenizer on random inputs cut into random chunks against split_string
+// and a naive splitter, with delimiters split across several chunks, empty tokens and every flag
+void check_tokenizer(void) {
+    static const char *const delimiters[] = {",", "::", "<->", "abab"};
+    static const char alphabet[] = "ab:,<->x";
+    char text[300];
+    StringView expected[301];
+    size_t failed = 0;
+
+    srand(17);
+    for (int i = 0; i < 40000; i++) {
+        size_t length = (size_t)rand() % (i % 10 == 0 ? sizeof(text) : 40);
+        for (size_t j = 0; j < length; j++) text[j] = alphabet[(size_t)rand() % (sizeof(alphabet) - 1)];
+        StringView input = {text, length};
+        StringView delimiter = cstr_view(delimiters[(size_t)i % 4]);
+        int flags = (i / 4) % 4; // Every combination of TOKENIZER_DELIMITER_SET and TOKENIZER_SKIP_EMPTY
+        size_t expected_count = check_tokenizer_reference(input, delimiter, flags, expected, sizeof(expected) / sizeof(expected[0]));
+
+        // The naive splitter must agree with split_string wherever both apply
+        if (delimiter.len == 1 && flags == 0) {
+            String str = view_to_string(input);
+            size_t count;
+            String *parts = split_string(&str, delimiter.ptr[0], &count);
+            failed += count != expected_count;
+            for (size_t j = 0; j < count && j < expected_count; j++) {
+                failed += !views_equal(string_view(&parts[j]), expected[j]);
+            }
+            free_string_array(parts, count);
+            free_string(&str);
+        }
+
+        // Chunks of one to a few bytes, so a delimiter often spans two or more of them
+        StreamTokenizer tokenizer = create_stream_tokenizer(delimiter, flags);
+        size_t produced = 0, offset = 0;
+        StringView token;
+        for (;;) {
+            size_t chunk = rand() % 8 == 0 ? (size_t)rand() % 64 : (size_t)rand() % 4;
+            if (chunk > length - offset) chunk = length - offset;
+            StringView piece = {text + offset, chunk};
+            tokenizer_feed(&tokenizer, piece);
+            offset += chunk;
+            if (offset == length && rand() % 2) tokenizer_finish(&tokenizer); // Finish with the last chunk or after empty ones
+            while (tokenizer_next(&tokenizer, &token)) {
+                failed += produced >= expected_count || !views_equal(token, expected[produced]);
+                produced++;
+            }
+            if (tokenizer.finished) break;
+        }
+        failed += produced != expected_count;
+        free_stream_tokenizer(&tokenizer);
+    }
+    printf("check tokenizer chunkings against split_string: %s\n", failed ? "FAILED" : "ok");
+}
+
+// Function to decode encoded in random chunk sizes, appending to out
+// Returns 0 on success and -1 as soon as a chunk is rejected or the input stops inside a record
+static int check_rle_decode_chunks(StringView encoded, StringBuilder *out) {
+    RleDecoder decoder = create_rle_decoder();
+    for (size_t offset = 0; offset < encoded.len;) {
+        size_t chunk = rand() % 8 == 0 ? (size_t)rand() % 300 : (size_t)rand() % 5;
+        if (chunk > encoded.len - offset) chunk = encoded.len - offset;
+        StringView piece = {encoded.ptr + offset, chunk};
+        if (rle_decoder_feed(&decoder, piece, out) != 0) return -1;
+        offset += chunk;
+    }
+    return rle_decoder_finish(&decoder);
+}
+
+// Function to check the streaming RLE codec: random inputs round-trip through both ends in random
+// chunk sizes, and truncated, over-long and oversized records are rejected without output
+void check_rle(void) {
+    unsigned char text[2000];
+    size_t failed = 0;
+
+    srand(29);
+    for (int i = 0; i < 20000; i++) {
+        // Runs of every length between literal stretches, so runs and records straddle the chunks
+        size_t length = 0, limit = (size_t)rand() % (i % 10 == 0 ? sizeof(text) : 200);
+        while (length < limit) {
+            size_t run = rand() % 3 == 0 ? 1 + (size_t)rand() % 300 : 1 + (size_t)rand() % 3;
+            if (run > limit - length) run = limit - length;
+            memset(text + length, "aab\0\xFF"[rand() % 5], run);
+            length += run;
+        }
+        StringView input = {(const char *)text, length};
+
+        StringBuilder encoded = create_string_builder(0);
+        RleEncoder encoder = create_rle_encoder();
+        for (size_t offset = 0; offset < length;) {
+            size_t chunk = rand() % 8 == 0 ? (size_t)rand() % 400 : (size_t)rand() % 5;
+            if (chunk > length - offset) chunk = length - offset;
+            StringView piece = {input.ptr + offset, chunk};
+            rle_encoder_feed(&encoder, piece, &encoded);
+            offset += chunk;
+        }
+        rle_encoder_finish(&encoder, &encoded);
+
+        StringView records = {encoded.data ? encoded.data : "", encoded.length};
+        StringBuilder decoded = create_string_builder(0);
+        failed += check_rle_decode_chunks(records, &decoded) != 0;
+        failed += decoded.length != length || (length && memcmp(decoded.data, text, length) != 0);
+        failed += rle_decoded_length(records) != length;
+
+        // Any cut decodes to a prefix of the input, and is complete only where a record ends
+        if (records.len) {
+            StringView cut = {records.ptr, (size_t)rand() % records.len};
+            decoded.length = 0;
+            int status = check_rle_decode_chunks(cut, &decoded);
+            failed += decoded.length > length || (decoded.length && memcmp(decoded.data, text, decoded.length) != 0);
+            failed += rle_decoded_length(cut) != (status == 0 ? decoded.length : STRING_NOT_FOUND);
+        }
+        free_string_builder(&decoded);
+        free_string_builder(&encoded);
+    }
+
+    // Truncated varints: a header whose last byte still has the continuation bit set
+    static const StringView truncated[] = {{"\x80", 1}, {"\xFF\xFF", 2}, {"\x02" "ab\x81", 4}};
+    for (size_t i = 0; i < sizeof(truncated) / sizeof(truncated[0]); i++) {
+        StringView encoded = truncated[i];
+        StringBuilder out = create_string_builder(0);
+        failed += check_rle_decode_chunks(encoded, &out) == 0;
+        failed += rle_decoded_length(encoded) != STRING_NOT_FOUND;
+        free_string_builder(&out);
+    }
+
+    // Over-long varints: a tenth byte above 1 or an eleventh byte does not fit in 64 bits
+    static const StringView overlong[] = {{"\x80\x80\x80\x80\x80\x80\x80\x80\x80\x02x", 11},
+                                          {"\x81\x80\x80\x80\x80\x80\x80\x80\x80\x81\x00x", 12},
+                                          {"\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\x01x", 12}};
+    for (size_t i = 0; i < sizeof(overlong) / sizeof(overlong[0]); i++) {
+        StringView encoded = overlong[i];
+        StringBuilder out = create_string_builder(0);
+        failed += check_rle_decode_chunks(encoded, &out) == 0 || out.length != 0;
+        failed += rle_decoded_length(encoded) != STRING_NOT_FOUND;
+        free_string_builder(&out);
+    }
+
+    // A run declaring RLE_MAX_DECODED bytes measures fine; one more is rejected before anything is allocated
+    for (size_t extra = 0; extra <= 1; extra++) {
+        StringBuilder encoded = create_string_builder(0);
+        rle_put_run(&encoded, 'r', (uint64_t)RLE_MAX_DECODED + extra);
+        StringView records = {encoded.data, encoded.length};
+        failed += rle_decoded_length(records) != RLE_MAX_DECODED + extra;
+        if (extra) {
+            StringBuilder out = create_string_builder(0);
+            failed += check_rle_decode_chunks(records, &out) == 0 || out.length != 0;
+            free_string_builder(&out);
+        }
+        free_string_builder(&encoded);
+    }
+
+    // Output already near the limit: a small record that would cross it is refused too
+    StringBuilder encoded = create_string_builder(0);
+    rle_put_run(&encoded, 'r', 100);
+    StringView records = {encoded.data, encoded.length};
+    RleDecoder decoder = create_rle_decoder();
+    StringBuilder out = create_string_builder(0);
+    out.length = RLE_MAX_DECODED - 50; // Only the length is compared before anything is written
+    failed += rle_decoder_feed(&decoder, records, &out) == 0 || out.length != RLE_MAX_DECODED - 50;
+    out.length = 0;
+    free_string_builder(&out);
+    free_string_builder(&encoded);
+
+    printf("check RLE streaming round trips and malformed records: %s\n", failed ? "FAILED" : "ok");
+}
+
+// Function to check replace_substring_inplace against replace_substring on random text, with
+// shrinking, equal-length and growing replacements, self-overlapping targets like "aba" in "ababa",
+// inline, heap and shared Strings
+void check_replace_inplace(void) {
+    static const char *const targets[] = {"a", "ab", "aba", "abab", "bb", "ababa"};
+    static const char *const replacements[] = {"", "x", "yz", "xyz", "ba", "0123456789abcdefghijklmnopqrstuvwxyz"};
+    char text[400];
+    size_t failed = 0;
+
+    // The cases the review named, then random ones
+    static const struct {
+        const char *input, *target, *replacement, *expected;
+    } cases[] = {
+        {"ababa", "aba", "X", "Xba"},
+        {"ababa", "aba", "abaaba", "abaababa"},
+        {"abababa", "aba", "", "b"},
+        {"aaaa", "aa", "a", "aa"},
+        {"aaa", "a", "aaa", "aaaaaaaaa"},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        String str = create_string(cases[i].input);
+        replace_substring_inplace(&str, cstr_view(cases[i].target), cstr_view(cases[i].replacement));
+        failed += strcmp(string_data(&str), cases[i].expected) != 0;
+        free_string(&str);
+    }
+
+    srand(37);
+    for (int i = 0; i < 30000; i++) {
+        size_t length = (size_t)rand() % (i % 10 == 0 ? sizeof(text) : 40);
+        for (size_t j = 0; j < length; j++) text[j] = "aab"[rand() % 3];
+        text[length] = '\0';
+        const char *target = targets[(size_t)rand() % 6];
+        const char *replacement = replacements[(size_t)rand() % 6];
+
+        String original = create_string(text);
+        String expected = replace_substring(&original, target, replacement);
+        size_t matches = 0;
+        for (const char *at = strstr(text, target); at; at = strstr(at + strlen(target), target)) matches++;
+
+        // A shared copy must be split off before the write and leave the original untouched
+        int shared = rand() % 4 == 0;
+        if (shared) share_string(&original);
+        String str = copy_string(&original);
+        size_t replaced = replace_substring_inplace(&str, cstr_view(target), cstr_view(replacement));
+        failed += replaced != matches || !views_equal(string_view(&str), string_view(&expected));
+        failed += string_data(&str)[str.length] != '\0';
+        failed += strcmp(string_data(&original), text) != 0;
+
+        free_string(&str);
+        free_string(&expected);
+        free_string(&original);
+    }
+    printf("check replace_substring_inplace against replace_substring: %s\n", failed ? "FAILED" : "ok");
+}
+
+// Benchmark suite (build with -DSTRING_BENCHMARK_SUITE)
+//
+// Every public operation runs next to a libc or naive baseline over inputs of 16 B to
+// BENCHMARK_SUITE_MAX_SIZE bytes in four shapes, and each measurement is written as one JSON
+// object per line: op, impl, shape, bytes, iterations, ns_per_op, gb_per_s and allocs_per_op.
+// Allocations come from the performance counters, so they are null under STRING_NO_TRACKING,
+// and timings include the counters' own cost unless they are compiled out, the clock reads as
+// well under STRING_TRACK_LATENCY.
+
+#ifndef BENCHMARK_SUITE_MAX_SIZE
+#define BENCHMARK_SUITE_MAX_SIZE ((size_t)64 << 20)
+#endif
+
+// Shortest time each measurement is repeated for
+#define BENCHMARK_SUITE_MIN_SECONDS 0.02
+
+// Define a struct to hold the inputs every benchmark body of one shape and size shares
+typedef struct {
+    String input;        // The text the operations run on
+    String half;         // The first half of input; the concatenate bodies join it to itself
+    String needle;       // "needle", found every 64 bytes in many_matches and once at the end of few_matches
+    String replacement;  // Longer than needle so the replaced result grows
+    String *tokens;      // input split on ','
+    size_t token_count;
+    String compressed;   // compress_string(input)
+} BenchmarkCase;
+
+// Signature of one benchmarked operation; it frees whatever it produces
+typedef void (*BenchmarkBody)(const BenchmarkCase *c);
+
+// Allocations made by the baselines, which the performance counters cannot see
+static size_t benchmark_baseline_allocations;
+
+// Function to malloc for a baseline, counting the allocation
+static void *benchmark_malloc(size_t bytes) {
+    void *ptr = malloc(bytes);
+    if (!ptr) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    benchmark_baseline_allocations++;
+    return ptr;
+}
+
+// Written by the baselines so the compiler cannot drop the work they do
+static volatile size_t benchmark_sink;
+
+// Function to concatenate the first half of the input with itself
+static void bench_concatenate(const BenchmarkCase *c) {
+    String result = concatenate_strings(&c->half, &c->half);
+    free_string(&result);
+}
+
+// Function to concatenate the first half with itself using malloc and memcpy
+static void baseline_concatenate(const BenchmarkCase *c) {
+    char *result = (char *)benchmark_malloc(2 * c->half.length + 1);
+    memcpy(result, string_data(&c->half), c->half.length);
+    memcpy(result + c->half.length, string_data(&c->half), c->half.length + 1);
+    benchmark_sink = (size_t)result[0];
+    free(result);
+}
+
+// Function to find the needle
+static void bench_find(const BenchmarkCase *c) {
+    benchmark_sink = (size_t)find_substring(&c->input, string_data(&c->needle));
+}
+
+// Function to find the needle with strstr
+static void baseline_find(const BenchmarkCase *c) {
+    benchmark_sink = (size_t)strstr(string_data(&c->input), string_data(&c->needle));
+}
+
+// Function to replace every needle through the char* overload
+static void bench_replace(const BenchmarkCase *c) {
+    String result = replace_substring(&c->input, string_data(&c->needle), string_data(&c->replacement));
+    free_string(&result);
+}
+
+// Function to replace every needle through the String overload
+static void bench_replace_string(const BenchmarkCase *c) {
+    String result = replace_substring_string(&c->input, &c->needle, &c->replacement);
+    free_string(&result);
+}
+
+// Function to replace every needle with strstr, growing the output by doubling as it goes
+static void baseline_replace(const BenchmarkCase *c) {
+    const char *src = string_data(&c->input);
+    size_t capacity = c->input.length + 1, length = 0;
+    char *result = (char *)benchmark_malloc(capacity);
+    for (const char *match; (match = strstr(src, string_data(&c->needle))) != NULL; src = match + c->needle.length) {
+        size_t needed = length + (size_t)(match - src) + c->replacement.length + 1;
+        if (needed > capacity) {
+            while (capacity < needed) capacity *= 2; // Double the capacity
+            result = (char *)realloc(result, capacity);
+            benchmark_baseline_allocations++;
+        }
+        memcpy(result + length, src, (size_t)(match - src));
+        length += (size_t)(match - src);
+        memcpy(result + length, string_data(&c->replacement), c->replacement.length);
+        length += c->replacement.length;
+    }
+    size_t rest = strlen(src);
+    if (length + rest + 1 > capacity) {
+        result = (char *)realloc(result, length + rest + 1);
+        benchmark_baseline_allocations++;
+    }
+    memcpy(result + length, src, rest + 1);
+    benchmark_sink = (size_t)result[0];
+    free(result);
+}
+
+// Function to split the input on ',' and free the parts
+static void bench_split(const BenchmarkCase *c) {
+    size_t count = 0;
+    String *parts = split_string(&c->input, ',', &count);
+    free_string_array(parts, count);
+}
+
+// Function to split on ',' with memchr and one malloc per token
+static void baseline_split(const BenchmarkCase *c) {
+    const char *data = string_data(&c->input), *end = data + c->input.length;
+    char **parts = (char **)benchmark_malloc((c->token_count + 1) * sizeof(char *));
+    size_t count = 0;
+    for (const char *start = data;; count++) {
+        const char *comma = (const char *)memchr(start, ',', (size_t)(end - start));
+        const char *stop = comma ? comma : end;
+        parts[count] = (char *)benchmark_malloc((size_t)(stop - start) + 1);
+        memcpy(parts[count], start, (size_t)(stop - start));
+        parts[count][stop - start] = '\0';
+        if (!comma) break;
+        start = comma + 1;
+    }
+    for (size_t i = 0; i <= count; i++) {
+        free(parts[i]);
+    }
+    free(parts);
+}
+
+// Function to split the input at every ',' or ' ', skipping empty tokens, and free the parts
+static void bench_split_any(const BenchmarkCase *c) {
+    size_t count = 0;
+    String *parts = split_string_any(&c->input, ", ", &count);
+    free_string_array(parts, count);
+}
+
+// Function to split at every ',' or ' ' with strspn/strcspn and one malloc per token, like strtok on a copy
+static void baseline_split_any(const BenchmarkCase *c) {
+    const char *data = string_data(&c->input);
+    size_t capacity = 16, count = 0;
+    char **parts = (char **)benchmark_malloc(capacity * sizeof(char *));
+    for (const char *start = data + strspn(data, ", "); *start; start += strspn(start, ", ")) {
+        size_t length = strcspn(start, ", ");
+        if (count == capacity) {
+            capacity *= 2; // Double the capacity
+            parts = (char **)realloc(parts, capacity * sizeof(char *));
+            if (!parts) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+            benchmark_baseline_allocations++;
+        }
+        parts[count] = (char *)benchmark_malloc(length + 1);
+        memcpy(parts[count], start, length);
+        parts[count++][length] = '\0';
+        start += length;
+    }
+    for (size_t i = 0; i < count; i++) {
+        free(parts[i]);
+    }
+    free(parts);
+}
+
+// Function to join the split tokens back with ','
+static void bench_join(const BenchmarkCase *c) {
+    String result = join_strings(c->tokens, c->token_count, ",");
+    free_string(&result);
+}
+
+// Function to join the tokens with memcpy into an exactly sized buffer
+static void baseline_join(const BenchmarkCase *c) {
+    char *result = (char *)benchmark_malloc(c->input.length + 1);
+    size_t length = 0;
+    for (size_t i = 0; i < c->token_count; i++) {
+        if (i > 0) result[length++] = ',';
+        memcpy(result + length, string_data(&c->tokens[i]), c->tokens[i].length);
+        length += c->tokens[i].length;
+    }
+    result[length] = '\0';
+    benchmark_sink = length;
+    free(result);
+}
+
+// Function to compress the input
+static void bench_compress(const BenchmarkCase *c) {
+    String result = compress_string(&c->input);
+    free_string(&result);
+}
+
+// Function to decompress the compressed input
+static void bench_decompress(const BenchmarkCase *c) {
+    String result = decompress_string(&c->compressed);
+    free_string(&result);
+}
+
+// Function to copy the input once, the memory bandwidth ceiling for any single-pass operation
+static void baseline_memcpy(const BenchmarkCase *c) {
+    char *result = (char *)benchmark_malloc(c->input.length + 1);
+    memcpy(result, string_data(&c->input), c->input.length + 1);
+    benchmark_sink = (size_t)result[0];
+    free(result);
+}
+
+// Function to convert the input to upper case
+static void bench_upper(const BenchmarkCase *c) {
+    String result = to_upper_case(&c->input);
+    free_string(&result);
+}
+
+// Function to convert the input to lower case
+static void bench_lower(const BenchmarkCase *c) {
+    String result = to_lower_case(&c->input);
+    free_string(&result);
+}
+
+// Function to convert the input to upper case with toupper
+static void baseline_upper(const BenchmarkCase *c) {
+    const char *src = string_data(&c->input);
+    char *result = (char *)benchmark_malloc(c->input.length + 1);
+    for (size_t i = 0; i <= c->input.length; i++) {
+        result[i] = (char)toupper((unsigned char)src[i]);
+    }
+    benchmark_sink = (size_t)result[0];
+    free(result);
+}
+
+// Function to convert the input to lower case with tolower
+static void baseline_lower(const BenchmarkCase *c) {
+    const char *src = string_data(&c->input);
+    char *result = (char *)benchmark_malloc(c->input.length + 1);
+    for (size_t i = 0; i <= c->input.length; i++) {
+        result[i] = (char)tolower((unsigned char)src[i]);
+    }
+    benchmark_sink = (size_t)result[0];
+    free(result);
+}
+
+// Function to pad the input on the left by a quarter of its length
+static void bench_pad_left(const BenchmarkCase *c) {
+    String result = pad_left(&c->input, c->input.length + c->input.length / 4 + 1, '*');
+    free_string(&result);
+}
+
+// Function to pad the input on the right by a quarter of its length
+static void bench_pad_right(const BenchmarkCase *c) {
+    String result = pad_right(&c->input, c->input.length + c->input.length / 4 + 1, '*');
+    free_string(&result);
+}
+
+// Function to pad the input on the left with malloc, memset and memcpy
+static void baseline_pad(const BenchmarkCase *c) {
+    size_t total = c->input.length + c->input.length / 4 + 1;
+    char *result = (char *)benchmark_malloc(total + 1);
+    memset(result, '*', total - c->input.length);
+    memcpy(result + total - c->input.length, string_data(&c->input), c->input.length + 1);
+    benchmark_sink = (size_t)result[0];
+    free(result);
+}
+
+// Every measured operation, each string.c implementation followed by its baseline
+static const struct {
+    const char *op;
+    const char *impl;
+    BenchmarkBody body;
+} benchmark_bodies[] = {
+    {"concatenate_strings", "string.c", bench_concatenate},
+    {"concatenate_strings", "malloc+memcpy", baseline_concatenate},
+    {"find_substring", "string.c", bench_find},
+    {"find_substring", "strstr", baseline_find},
+    {"replace_substring", "string.c", bench_replace},
+    {"replace_substring_string", "string.c", bench_replace_string},
+    {"replace_substring", "strstr loop", baseline_replace},
+    {"split_string", "string.c", bench_split},
+    {"split_string", "memchr+malloc", baseline_split},
+    {"split_string_any", "string.c", bench_split_any},
+    {"split_string_any", "strspn+strcspn", baseline_split_any},
+    {"join_strings", "string.c", bench_join},
+    {"join_strings", "memcpy", baseline_join},
+    {"compress_string", "string.c", bench_compress},
+    {"compress_string", "memcpy", baseline_memcpy},
+    {"decompress_string", "string.c", bench_decompress},
+    {"to_upper_case", "string.c", bench_upper},
+    {"to_upper_case", "toupper loop", baseline_upper},
+    {"to_lower_case", "string.c", bench_lower},
+    {"to_lower_case", "tolower loop", baseline_lower},
+    {"pad_left", "string.c", bench_pad_left},
+    {"pad_right", "string.c", bench_pad_right},
+    {"pad_left", "memset+memcpy", baseline_pad},
+};
+
+// Names of the input shapes, in the order benchmark_fill knows them
+static const char *const benchmark_shapes[] = {"random", "repetitive", "many_matches", "few_matches"};
+
+// Function to step a xorshift generator so every run sees the same inputs
+static uint64_t benchmark_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// Function to fill size bytes with text of the given shape; mixed-case words with a ',' about every 32 bytes
+static void benchmark_fill(char *text, size_t size, size_t shape) {
+    static const char letters[] = "abcdefghijklmopqrstuvwxyzABCDEFGHIJKLMOPQRSTUVWXYZ "; // No 'n', so no accidental needles
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < size;) {
+        uint64_t r = benchmark_random(&state);
+        if (shape == 1) {
+            size_t run = 1 + (size_t)(r % 64); // Runs of one byte, the case RLE is for
+            char byte = (r >> 8) % 32 == 0 ? ',' : letters[(r >> 16) % (sizeof(letters) - 1)];
+            for (; run > 0 && i < size; run--) text[i++] = byte;
+        } else if (shape == 2 && i % 64 == 0 && i + 6 <= size) {
+            memcpy(text + i, "needle", 6);
+            i += 6;
+        } else {
+            text[i++] = r % 32 == 0 ? ',' : letters[(r >> 8) % (sizeof(letters) - 1)];
+        }
+    }
+    if (shape == 3 && size >= 6) memcpy(text + size - 6, "needle", 6); // The only match, after a full scan
+    text[size] = '\0';
+}
+
+// Function to run one body for at least BENCHMARK_SUITE_MIN_SECONDS and write its JSON line
+// Iterations are timed in batches that double in size, keeping the clock out of short operations
+static void benchmark_measure(FILE *out, size_t body, size_t shape, const BenchmarkCase *c) {
+    benchmark_bodies[body].body(c); // Warm up caches and the allocator
+
+    PerformanceTracker before = snapshot_performance();
+    size_t baseline_before = benchmark_baseline_allocations;
+    size_t iterations = 0;
+    double elapsed = 0;
+    for (size_t batch = 1; elapsed < BENCHMARK_SUITE_MIN_SECONDS; batch *= 2) {
+        double start = benchmark_now();
+        for (size_t i = 0; i < batch; i++) {
+            benchmark_bodies[body].body(c);
+        }
+        elapsed += benchmark_now() - start;
+        iterations += batch;
+    }
+    PerformanceTracker after = snapshot_performance();
+
+    double ns_per_op = elapsed * 1e9 / (double)iterations;
+    fprintf(out, "{\"op\":\"%s\",\"impl\":\"%s\",\"shape\":\"%s\",\"bytes\":%zu,\"iterations\":%zu,"
+            "\"ns_per_op\":%.2f,\"gb_per_s\":%.4f,\"allocs_per_op\":",
+            benchmark_bodies[body].op, benchmark_bodies[body].impl, benchmark_shapes[shape], c->input.length,
+            iterations, ns_per_op, (double)c->input.length / ns_per_op);
+#ifdef STRING_NO_TRACKING
+    (void)before;
+    (void)after;
+    (void)baseline_before;
+    fprintf(out, "null}\n");
+#else
+    size_t allocations = after.allocations - before.allocations + benchmark_baseline_allocations - baseline_before;
+    fprintf(out, "%.2f}\n", (double)allocations / (double)iterations);
+#endif
+    fflush(out);
+}
+
+// Function to run every body over every shape at sizes 16 B, 64 B, ... up to BENCHMARK_SUITE_MAX_SIZE
+void benchmark_suite(FILE *out) {
+    for (size_t size = 16; size <= BENCHMARK_SUITE_MAX_SIZE; size *= 4) {
+        char *text = (char *)malloc(size + 1);
+        if (!text) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t shape = 0; shape < sizeof(benchmark_shapes) / sizeof(benchmark_shapes[0]); shape++) {
+            benchmark_fill(text, size, shape);
+
+            BenchmarkCase c;
+            StringView text_view = {text, size};
+            c.input = view_to_string(text_view);
+            c.half = substring(&c.input, 0, size / 2);
+            c.needle = create_string("needle");
+            c.replacement = create_string("needle+replacement");
+            c.tokens = split_string(&c.input, ',', &c.token_count);
+            c.compressed = compress_string(&c.input);
+
+            for (size_t body = 0; body < sizeof(benchmark_bodies) / sizeof(benchmark_bodies[0]); body++) {
+                benchmark_measure(out, body, shape, &c);
+            }
+
+            free_string_array(c.tokens, c.token_count);
+            free_string(&c.compressed);
+            free_string(&c.replacement);
+            free_string(&c.needle);
+            free_string(&c.half);
+            free_string(&c.input);
+        }
+        free(text);
     }
-    
-    *count = tokens_count; // Update count
-    free(copy); // Free the temporary copy
-    
-    return tokens;
 }
+#endif